@@ -0,0 +1,415 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "circuit.h"
+#include "generators.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Microbenchmarks for simulation, saving/loading and editor operations on synthetic circuits.
+ * Results are written to stdout as csv (default) or json lines so they can be compared between versions.
+*/
+
+struct Options {
+	int gates = 4096;
+	int steps = 0;
+	uint32_t seed = 1;
+	std::string topology = "all";
+	std::string label = "local";
+	std::string file = "benchmark_save.txt";
+	std::string project;
+	SimulationMode engine = SimulationMode::BATCHED;
+	// auto, scalar, avx2, avx512 or all to compare every set the cpu supports
+	std::string kernels = "auto";
+	// locality, creation or all to compare the gate order of the batched engine
+	std::string order = "locality";
+	int threads = 1;
+	// Adds rows for the threads of one, two, ... NUMA nodes, with and without pinning
+	bool scaling = false;
+	bool json = false;
+};
+
+struct Result {
+	std::string benchmark;
+	std::string topology;
+	size_t gates;
+	size_t connections;
+	long long iterations;
+	double totalMs;
+	uint64_t bytes = 0;
+	long long cacheMisses = -1;
+};
+
+static const char *topologies[] = { "adder", "dag", "registers", "ring" };
+static const KernelSet kernelSets[] = { KernelSet::SCALAR, KernelSet::AVX2, KernelSet::AVX512 };
+
+// Counts the cache misses of this process with perf events, where the kernel allows it
+class CacheMissCounter {
+	int fd = -1;
+
+public:
+	CacheMissCounter() {
+#ifdef __linux__
+		perf_event_attr attributes;
+		std::memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+	}
+	~CacheMissCounter() {
+#ifdef __linux__
+		if (fd >= 0) { close(fd); }
+#endif
+	}
+
+	void start() {
+#ifdef __linux__
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+	// Returns -1 if the counter is not available
+	long long stop() {
+#ifdef __linux__
+		long long count = 0;
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd, &count, sizeof(count)) == sizeof(count)) { return count; }
+		}
+#endif
+		return -1;
+	}
+};
+
+static double timeMs(const std::function<void()> &function) {
+	auto start = std::chrono::high_resolution_clock::now();
+	function();
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static size_t countConnections(const Circuit &circuit) {
+	size_t count = 0;
+	for (auto &gate : circuit.gates) {
+		for (auto &input : gate->inputs) {
+			if (circuit.gates.get(input.src)) { count++; }
+		}
+	}
+	return count;
+}
+
+static void buildCircuit(Circuit &circuit, const std::string &topology, const Options &options) {
+	if (topology == "adder") {
+		generateRippleAdder(circuit, std::max(1, options.gates / 7), Point{ 0,0 });
+	}
+	else if (topology == "dag") {
+		RandomNetlistParameters parameters;
+		parameters.gates = options.gates;
+		parameters.seed = options.seed;
+		generateRandomNetlist(circuit, parameters, Point{ 0,0 });
+	}
+	else if (topology == "registers") {
+		const int bits = 32;
+		generateRegisterFile(circuit, std::max(1, options.gates / (bits * 3)), bits, Point{ 0,0 });
+	}
+	else if (topology == "ring") {
+		generateFeedbackRing(circuit, options.gates, Point{ 0,0 });
+	}
+	else if (topology == "project") {
+		circuit.loadProject(options.project);
+	}
+}
+
+static void printResult(const Result &result, const Options &options) {
+	double nsPerOp = result.totalMs * 1e6 / result.iterations;
+	double opsPerSec = result.iterations / (result.totalMs / 1000.0);
+
+	if (options.json) {
+		std::cout << "{\"label\":\"" << options.label << "\",\"benchmark\":\"" << result.benchmark << "\",\"topology\":\"" << result.topology
+			<< "\",\"gates\":" << result.gates << ",\"connections\":" << result.connections << ",\"iterations\":" << result.iterations
+			<< ",\"total_ms\":" << result.totalMs << ",\"ns_per_op\":" << nsPerOp << ",\"ops_per_sec\":" << opsPerSec << ",\"bytes\":" << result.bytes << ",\"cache_misses\":" << result.cacheMisses << "}\n";
+	}
+	else {
+		std::cout << options.label << "," << result.benchmark << "," << result.topology << "," << result.gates << "," << result.connections << ","
+			<< result.iterations << "," << result.totalMs << "," << nsPerOp << "," << opsPerSec << "," << result.bytes << "," << result.cacheMisses << "\n";
+	}
+}
+
+static void runTopology(const std::string &topology, const Options &options) {
+	Circuit circuit;
+	circuit.simulationMode = options.engine;
+	circuit.engine.setLocalityOrder(options.order != "creation");
+	circuit.engine.setThreadCount(options.threads);
+	for (KernelSet set : kernelSets) {
+		if (options.kernels == kernelSetName(set)) {
+			circuit.engine.setKernelSet(set);
+		}
+	}
+	buildCircuit(circuit, topology, options);
+	size_t gates = circuit.gates.size();
+	if (gates == 0) {
+		std::cerr << "No gates in " << topology << "\n";
+		return;
+	}
+	size_t connections = countConnections(circuit);
+
+	// Simulation steps
+	int steps = options.steps > 0 ? options.steps : std::max(10, static_cast<int>(20000000 / std::max<size_t>(gates, 1)));
+	double simulateMs = circuit.simulate(steps);
+	printResult({ "simulate", topology, gates, connections, steps, simulateMs }, options);
+
+	if (options.threads > 1 && options.engine == SimulationMode::BATCHED) {
+		const Partitioning &partitioning = circuit.engine.getPartitioning();
+		std::cerr << topology << ": " << partitioning.partSizes.size() << " parts, " << partitioning.cutConnections << " of "
+			<< partitioning.connections << " connections cut (" << 100.0 * partitioning.cutConnections / std::max<size_t>(partitioning.connections, 1)
+			<< "%), largest part " << partitioning.imbalance() << "x the average\n";
+	}
+
+	if (options.kernels == "all" && options.engine == SimulationMode::BATCHED) {
+		for (KernelSet set : kernelSets) {
+			if (set > detectKernelSet()) { continue; }
+
+			circuit.engine.setKernelSet(set);
+			double kernelMs = circuit.simulate(steps);
+			printResult({ std::string("simulate_") + kernelSetName(set), topology, gates, connections, steps, kernelMs }, options);
+		}
+		circuit.engine.setKernelSet(detectKernelSet());
+	}
+
+	if (options.order == "all" && options.engine == SimulationMode::BATCHED) {
+		CacheMissCounter counter;
+		for (bool locality : { false, true }) {
+			// Compile outside of the measurement
+			circuit.engine.setLocalityOrder(locality);
+			circuit.simulate(1);
+
+			counter.start();
+			double orderMs = circuit.simulate(steps);
+			long long misses = counter.stop();
+
+			Result result{ locality ? "simulate_locality_order" : "simulate_creation_order", topology, gates, connections, steps, orderMs };
+			result.cacheMisses = misses;
+			printResult(result, options);
+		}
+	}
+
+	if (options.scaling && options.engine == SimulationMode::BATCHED) {
+		const NumaTopology &numa = circuit.engine.getTopology();
+		size_t threads = 0;
+		for (size_t nodes = 1; nodes <= numa.nodeCount(); nodes++) {
+			threads += std::max<size_t>(1, numa.nodeCpus[nodes - 1].size());
+			circuit.engine.setThreadCount(static_cast<int>(threads));
+			for (bool pinned : { true, false }) {
+				circuit.engine.setNumaNodes(pinned ? nodes : 0);
+				circuit.simulate(1);
+
+				double scalingMs = circuit.simulate(steps);
+				std::string name = "simulate_" + std::to_string(nodes) + "_nodes_" + std::to_string(threads) + "_threads" + (pinned ? "_pinned" : "_unpinned");
+				printResult({ name, topology, gates, connections, steps, scalingMs }, options);
+			}
+		}
+		circuit.engine.setThreadCount(options.threads);
+		circuit.engine.setNumaNodes(numa.nodeCount());
+	}
+
+	// Saving and loading
+	const int fileRepeats = 3;
+	double saveMs = 0;
+	for (int i = 0; i < fileRepeats; i++) {
+		saveMs += circuit.saveSnapshot(options.file);
+	}
+	uint64_t bytes = std::filesystem::file_size(options.file);
+	printResult({ "save", topology, gates, connections, fileRepeats, saveMs, bytes }, options);
+
+	double loadMs = 0;
+	for (int i = 0; i < fileRepeats; i++) {
+		Circuit loaded;
+		loadMs += loaded.loadProject(options.file);
+	}
+	printResult({ "load", topology, gates, connections, fileRepeats, loadMs, bytes }, options);
+
+	circuit.projectFormat = ProjectFormat::COMPRESSED;
+	double compressedSaveMs = 0;
+	for (int i = 0; i < fileRepeats; i++) {
+		compressedSaveMs += circuit.saveSnapshot(options.file);
+	}
+	uint64_t compressedBytes = std::filesystem::file_size(options.file);
+	printResult({ "save_compressed", topology, gates, connections, fileRepeats, compressedSaveMs, compressedBytes }, options);
+
+	double compressedLoadMs = 0;
+	for (int i = 0; i < fileRepeats; i++) {
+		Circuit loaded;
+		compressedLoadMs += loaded.loadProject(options.file);
+	}
+	printResult({ "load_compressed", topology, gates, connections, fileRepeats, compressedLoadMs, compressedBytes }, options);
+
+	circuit.projectFormat = ProjectFormat::TILED;
+	double tiledSaveMs = 0;
+	for (int i = 0; i < fileRepeats; i++) {
+		tiledSaveMs += circuit.saveSnapshot(options.file);
+	}
+	uint64_t tiledBytes = std::filesystem::file_size(options.file);
+	printResult({ "save_tiled", topology, gates, connections, fileRepeats, tiledSaveMs, tiledBytes }, options);
+
+	// Opening a region around the first gate only loads the chunks near it
+	double regionMs = 0;
+	size_t regionGates = 0;
+	for (int i = 0; i < fileRepeats; i++) {
+		Circuit loaded;
+		Point corner = circuit.gates[0].position;
+		regionMs += loaded.openProject(options.file, corner, corner + Point{ 64, 32 });
+		regionGates = loaded.gates.size();
+	}
+	printResult({ "open_region_" + std::to_string(regionGates) + "_gates", topology, gates, connections, fileRepeats, regionMs, tiledBytes }, options);
+
+	// Saving a partially loaded project only holds up the caller while the loaded gates are copied
+	std::string regionFile = options.file + ".region";
+	double regionSaveMs = 0;
+	for (int i = 0; i < fileRepeats; i++) {
+		Circuit loaded;
+		Point corner = circuit.gates[0].position;
+		loaded.openProject(options.file, corner, corner + Point{ 64, 32 });
+		regionSaveMs += loaded.saveProjectAsync(regionFile);
+		loaded.waitForSaves();
+	}
+	printResult({ "save_region_async", topology, gates, connections, fileRepeats, regionSaveMs, std::filesystem::file_size(regionFile) }, options);
+	std::remove(regionFile.c_str());
+	circuit.projectFormat = ProjectFormat::TEXT;
+	circuit.saveSnapshot(options.file);
+
+	// Saving a few edits only appends them to the journal
+	const int edits = 1000;
+	std::mt19937 editRng(options.seed);
+	for (int i = 0; i < edits; i++) {
+		circuit.toggleComponent(circuit.gates[editRng() % gates].position);
+	}
+	double journalMs = circuit.saveProject(options.file);
+	std::string journal = options.file + ".journal";
+	uint64_t journalBytes = std::filesystem::exists(journal) ? std::filesystem::file_size(journal) : 0;
+	printResult({ "save_journal", topology, gates, connections, edits, journalMs, journalBytes }, options);
+
+	// Background saves only hold up the caller while the circuit is copied. Saving to another path than
+	// the last save always writes the whole project
+	std::string asyncFile = options.file + ".async";
+	double asyncMs = 0;
+	for (int i = 0; i < fileRepeats; i++) {
+		asyncMs += circuit.saveProjectAsync(i % 2 == 0 ? asyncFile : options.file);
+		circuit.waitForSaves();
+	}
+	printResult({ "save_async", topology, gates, connections, fileRepeats, asyncMs, bytes }, options);
+	std::remove(options.file.c_str());
+	std::remove(journal.c_str());
+	std::remove(asyncFile.c_str());
+	std::remove((asyncFile + ".journal").c_str());
+
+	// Collision probes, half of them on occupied tiles
+	Point min{ 0,0 };
+	Point max{ 0,0 };
+	for (auto &gate : circuit.gates) {
+		min = Point{ std::min(min.x, gate->position.x), std::min(min.y, gate->position.y) };
+		max = Point{ std::max(max.x, gate->position.x), std::max(max.y, gate->position.y) };
+	}
+
+	const int probes = 10000;
+	std::mt19937 rng(options.seed);
+	std::vector<Point> probePoints;
+	for (int i = 0; i < probes; i++) {
+		if (i % 2 == 0) {
+			probePoints.push_back(circuit.gates[rng() % gates].position);
+		}
+		else {
+			probePoints.push_back(Point{ max.x + 1 + static_cast<int>(rng() % 64), min.y + static_cast<int>(rng() % (max.y - min.y + 1)) });
+		}
+	}
+	double collisionMs = timeMs([&]() {
+		GateHandle gate;
+		for (auto &point : probePoints) {
+			circuit.checkCollision(gate, point);
+		}
+	});
+	printResult({ "check_collision", topology, gates, connections, probes, collisionMs }, options);
+
+	// Copy everything and paste it below the original, then delete the pasted copy
+	circuit.selectAllComponents();
+	double copyMs = timeMs([&]() { circuit.copySelected(Point{ 0,0 }); });
+	printResult({ "copy", topology, gates, connections, 1, copyMs, circuit.clipboard.size() }, options);
+
+	bool pasted = false;
+	double pasteMs = timeMs([&]() { pasted = circuit.pasteComponents(Point{ 0, max.y - min.y + 2 }); });
+	if (!pasted) {
+		std::cerr << "Paste collided in " << topology << "\n";
+		return;
+	}
+	printResult({ "paste", topology, gates, connections, 1, pasteMs }, options);
+
+	double deleteMs = timeMs([&]() { circuit.removeSelectedComponents(); });
+	printResult({ "delete_selection", topology, gates, connections, 1, deleteMs }, options);
+}
+
+int main(int argc, char **argv) {
+	Options options;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--gates" && hasValue) { options.gates = std::stoi(argv[++i]); }
+		else if (arg == "--steps" && hasValue) { options.steps = std::stoi(argv[++i]); }
+		else if (arg == "--seed" && hasValue) { options.seed = static_cast<uint32_t>(std::stoul(argv[++i])); }
+		else if (arg == "--topology" && hasValue) { options.topology = argv[++i]; }
+		else if (arg == "--label" && hasValue) { options.label = argv[++i]; }
+		else if (arg == "--file" && hasValue) { options.file = argv[++i]; }
+		else if (arg == "--project" && hasValue) { options.project = argv[++i]; }
+		else if (arg == "--engine" && hasValue) {
+			std::string engine = argv[++i];
+			options.engine = engine == "interpreted" ? SimulationMode::INTERPRETED : SimulationMode::BATCHED;
+		}
+		else if (arg == "--kernels" && hasValue) { options.kernels = argv[++i]; }
+		else if (arg == "--order" && hasValue) { options.order = argv[++i]; }
+		else if (arg == "--threads" && hasValue) { options.threads = std::stoi(argv[++i]); }
+		else if (arg == "--scaling") { options.scaling = true; }
+		else if (arg == "--json") { options.json = true; }
+		else {
+			std::cerr << "Usage: " << argv[0] << " [--gates N] [--steps N] [--seed N] [--topology adder|dag|registers|ring|all] [--label name] [--file path] [--project path] [--engine batched|interpreted] [--kernels auto|scalar|avx2|avx512|all] [--order locality|creation|all] [--threads N] [--scaling] [--json]\n";
+			return 1;
+		}
+	}
+
+	if (!options.json) {
+		std::cout << "label,benchmark,topology,gates,connections,iterations,total_ms,ns_per_op,ops_per_sec,bytes,cache_misses\n";
+	}
+
+	// A project file, for example written by the generator, replaces the synthetic topologies
+	if (!options.project.empty()) {
+		runTopology("project", options);
+		return 0;
+	}
+
+	for (const char *topology : topologies) {
+		if (options.topology == "all" || options.topology == topology) {
+			runTopology(topology, options);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Densely packed bits, 64 to a word. Bits past the size are always zero
+ * so that whole words can be scanned or compared without masking
+*/
+class BitVector {
+	std::vector<uint64_t> words;
+	size_t count = 0;
+
+public:
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	bool operator[](size_t index) const { return (words[index / 64] >> (index % 64)) & 1; }
+
+	void set(size_t index, bool value) {
+		uint64_t mask = uint64_t(1) << (index % 64);
+		if (value) { words[index / 64] |= mask; }
+		else { words[index / 64] &= ~mask; }
+	}
+	void push_back(bool value) {
+		if (count % 64 == 0) { words.push_back(0); }
+		set(count++, value);
+	}
+	void pop_back() {
+		set(--count, false);
+		if (count % 64 == 0) { words.pop_back(); }
+	}
+	void fill(bool value) {
+		std::fill(words.begin(), words.end(), value ? ~uint64_t(0) : 0);
+		if (value && count % 64 != 0) {
+			words.back() = (uint64_t(1) << (count % 64)) - 1;
+		}
+	}
+	void assign(size_t bits, bool value) {
+		words.assign((bits + 63) / 64, 0);
+		count = bits;
+		fill(value);
+	}
+	void clear() {
+		words.clear();
+		count = 0;
+	}
+	void reserve(size_t bits) { words.reserve((bits + 63) / 64); }
+	void swap(BitVector &other) {
+		words.swap(other.words);
+		std::swap(count, other.count);
+	}
+
+	size_t wordCount() const { return words.size(); }
+	uint64_t *data() { return words.data(); }
+	const uint64_t *data() const { return words.data(); }
+	uint64_t word(size_t index) const { return words[index]; }
+	// The bits of the last word past the size must be zero
+	void setWord(size_t index, uint64_t bits) { words[index] = bits; }
+};
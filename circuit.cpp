@@ -0,0 +1,1161 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "circuit.h"
+#include "serialization.h"
+#include "tiles.h"
+
+/*
+ * Saving and loading
+ *
+ * Edits are recorded in a journal, <project>.journal, so that saving only appends the edits since the last save.
+ * Each line is one edit, gates are referred to by id:
+ *   p,id,type,output,x,y           gate placed
+ *   m,id,x,y                       gate moved
+ *   d,id                           gate removed with its connections
+ *   c,dst id,src id,input,x,y,...  input connected along the points, replacing its previous connection
+ *   o,id,output                    output set, such as toggling an input
+ *   v,tile size,x,y,running        view of the editor
+ *   s,id,...                       the selected gates, replacing the selection
+ * Outputs and timer counters changed by simulating are not journaled, saving after simulating writes the whole project
+ *
+ * Compressed projects start with the bytes LSP 1, the view as varint tile size, signed varint world offset and a
+ * byte that is 1 if the simulation was running, followed by blocks compressed with lzCompress. The blocks hold
+ * records that never cross a block, so the file is read a block at a time:
+ *   varint gate count
+ *   per gate the signed varint id relative to the previous gate, a byte with the type, whether it is selected
+ *   in bit 6 and the output in the high bit, the signed varint position relative to the previous gate and for
+ *   timers the signed varint counter
+ *   varint connection count
+ *   per connection the signed varint id of the gate relative to the previous connection, the signed varint id
+ *   of the source relative to the gate, a byte with the input index, the varint point count and the signed
+ *   varint points relative to the previous point, which carries over from the previous connection
+*/
+static std::string journalPath(const std::string &path) {
+	return path + ".journal";
+}
+
+void Circuit::journalLine(const std::string &line) {
+	// Moves are journaled before the edit that follows them, so the journal replays in the same order
+	journalMoves();
+	pendingEdits += line;
+	pendingEdits += '\n';
+	pendingLines++;
+}
+void Circuit::journalMoves() {
+	if (movedGates.empty()) { return; }
+
+	auto moved = std::move(movedGates);
+	movedGates.clear();
+	movedIndices.clear();
+	for (auto &[gate, routes] : moved) {
+		Component *ptr = gates.get(gate);
+		if (!ptr) { continue; }
+
+		journalLine("m," + std::to_string(ptr->id) + "," + std::to_string(ptr->position.x) + "," + std::to_string(ptr->position.y));
+		for (size_t i = 0; i < ptr->inputs.size(); i++) {
+			if ((routes >> i & 1) && gates.get(ptr->inputs[i].src)) {
+				journalConnection(*ptr, static_cast<int>(i));
+			}
+		}
+	}
+}
+void Circuit::discardEdits() {
+	pendingEdits.clear();
+	pendingLines = 0;
+	movedGates.clear();
+	movedIndices.clear();
+	simulatedSinceSave = false;
+}
+void Circuit::journalGate(GateHandle gate) {
+	Component *ptr = gates.get(gate);
+	journalLine("p," + std::to_string(ptr->id) + "," + std::to_string(static_cast<int>(ptr->getType())) + "," + std::to_string(gates.output(gate))
+		+ "," + std::to_string(ptr->position.x) + "," + std::to_string(ptr->position.y));
+}
+void Circuit::journalConnection(const Component &dst, int input) {
+	std::string line = "c," + std::to_string(dst.id) + "," + std::to_string(gates.get(dst.inputs[input].src)->id) + "," + std::to_string(input);
+	for (auto &point : gates.route(dst.inputs[input])) {
+		line += "," + std::to_string(point.x) + "," + std::to_string(point.y);
+	}
+	journalLine(line);
+}
+
+ProjectSnapshot::Gate snapshotGate(const GateStore &gates, size_t dense) {
+	auto &gate = gates[dense];
+	int counter = gate.getType() == GateType::TIMER ? static_cast<const TIMER &>(gate).getCounter() : 0;
+	return { gate.id, gate.getType(), gates.output(dense), gate.position, gates.isSelected(dense), counter };
+}
+// Creates the gate with the state the snapshot has for it
+static GateHandle createGate(GateStore &gates, const ProjectSnapshot::Gate &gate) {
+	GateHandle handle = gates.create(gate.type, gate.position, gate.id);
+	gates.setOutput(handle, gate.output);
+	if (gate.selected) {
+		gates.select(gates.size() - 1);
+	}
+	if (gate.type == GateType::TIMER) {
+		static_cast<TIMER *>(gates.get(handle))->setCounter(gate.counter);
+	}
+	return handle;
+}
+
+ProjectSnapshot Circuit::takeSnapshot() const {
+	ProjectSnapshot snapshot;
+	snapshot.view = view;
+	snapshot.gates.reserve(gates.size());
+	for (size_t i = 0; i < gates.size(); i++) {
+		snapshot.gates.push_back(snapshotGate(gates, i));
+	}
+
+	for (auto &gate : gates) {
+		for (size_t i = 0; i < gate->inputs.size(); i++) {
+			if (auto input_ptr = gates.get(gate->inputs[i].src)) {
+				auto route = gates.route(gate->inputs[i]);
+				snapshot.connections.push_back({ gate->id, input_ptr->id, static_cast<int>(i), static_cast<uint32_t>(snapshot.points.size()), static_cast<uint32_t>(route.size()) });
+				snapshot.points.insert(snapshot.points.end(), route.begin(), route.end());
+			}
+		}
+	}
+	return snapshot;
+}
+
+static void appendNumber(std::string &text, int64_t value) {
+	char buffer[24];
+	auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+	text.append(buffer, result.ptr);
+}
+
+static std::string formatView(const ProjectView &view) {
+	std::string text = "view,";
+	appendNumber(text, view.tileSize);
+	text += ',';
+	appendNumber(text, view.worldOffset.x);
+	text += ',';
+	appendNumber(text, view.worldOffset.y);
+	text += view.running ? ",1" : ",0";
+	return text;
+}
+
+// The text of a project file, a line "view,tile size,x,y,running", a line per gate with its id, type, output and
+// position, followed by 1 if it is selected and the counter of timers, a line with "-", then a line per connection
+// with the ids of the gate and its input, the input index and the points
+static std::string formatProject(const ProjectSnapshot &snapshot) {
+	std::string text;
+	text.reserve(snapshot.gates.size() * 24 + snapshot.connections.size() * 24 + snapshot.points.size() * 8);
+
+	text += formatView(snapshot.view);
+	text += '\n';
+	for (auto &gate : snapshot.gates) {
+		appendNumber(text, static_cast<int64_t>(gate.id));
+		text += ',';
+		appendNumber(text, static_cast<int>(gate.type));
+		text += gate.output ? ",1," : ",0,";
+		appendNumber(text, gate.position.x);
+		text += ',';
+		appendNumber(text, gate.position.y);
+		if (gate.selected || gate.type == GateType::TIMER) {
+			text += gate.selected ? ",1" : ",0";
+		}
+		if (gate.type == GateType::TIMER) {
+			text += ',';
+			appendNumber(text, gate.counter);
+		}
+		text += '\n';
+	}
+
+	text += "-\n";
+
+	for (auto &connection : snapshot.connections) {
+		appendNumber(text, static_cast<int64_t>(connection.dst));
+		text += ',';
+		appendNumber(text, static_cast<int64_t>(connection.src));
+		text += ',';
+		appendNumber(text, connection.input);
+		for (uint32_t i = connection.pointOffset; i < connection.pointOffset + connection.pointCount; i++) {
+			text += ',';
+			appendNumber(text, snapshot.points[i].x);
+			text += ',';
+			appendNumber(text, snapshot.points[i].y);
+		}
+		text += '\n';
+	}
+	return text;
+}
+
+static const uint8_t projectMagic[] = { 'L', 'S', 'P', 1 };
+
+void writeSnapshotBlocks(const ProjectSnapshot &snapshot, ByteWriter &out) {
+	ByteWriter block;
+	auto endRecord = [&]() {
+		if (block.bytes.size() >= compressedBlockSize) {
+			writeCompressedBlock(out, block.bytes.data(), block.bytes.size());
+			block.bytes.clear();
+		}
+	};
+
+	block.writeVarint(snapshot.gates.size());
+	endRecord();
+	uint64_t prevId = 0;
+	Point prev{ 0, 0 };
+	for (auto &gate : snapshot.gates) {
+		block.writeSignedVarint(static_cast<int64_t>(gate.id - prevId));
+		block.writeByte(static_cast<uint8_t>(gate.type) | (gate.selected << 6) | (gate.output << 7));
+		block.writeSignedVarint(gate.position.x - prev.x);
+		block.writeSignedVarint(gate.position.y - prev.y);
+		if (gate.type == GateType::TIMER) {
+			block.writeSignedVarint(gate.counter);
+		}
+		prevId = gate.id;
+		prev = gate.position;
+		endRecord();
+	}
+
+	block.writeVarint(snapshot.connections.size());
+	endRecord();
+	prevId = 0;
+	prev = Point{ 0, 0 };
+	for (auto &connection : snapshot.connections) {
+		block.writeSignedVarint(static_cast<int64_t>(connection.dst - prevId));
+		block.writeSignedVarint(static_cast<int64_t>(connection.src - connection.dst));
+		block.writeByte(static_cast<uint8_t>(connection.input));
+		block.writeVarint(connection.pointCount);
+		for (uint32_t i = connection.pointOffset; i < connection.pointOffset + connection.pointCount; i++) {
+			block.writeSignedVarint(snapshot.points[i].x - prev.x);
+			block.writeSignedVarint(snapshot.points[i].y - prev.y);
+			prev = snapshot.points[i];
+		}
+		prevId = connection.dst;
+		endRecord();
+	}
+
+	// The last block is always written, so the blocks end where the records do
+	writeCompressedBlock(out, block.bytes.data(), block.bytes.size());
+}
+
+void writeViewFields(const ProjectView &view, ByteWriter &out) {
+	out.writeVarint(view.tileSize);
+	out.writeSignedVarint(view.worldOffset.x);
+	out.writeSignedVarint(view.worldOffset.y);
+	out.writeByte(view.running);
+}
+bool readViewFields(std::istream &stream, ProjectView &view) {
+	uint64_t tileSize = 0;
+	uint64_t x = 0;
+	uint64_t y = 0;
+	int running = 0;
+	if (!readVarint(stream, tileSize) || !readVarint(stream, x) || !readVarint(stream, y) || (running = stream.get()) == EOF) { return false; }
+
+	auto zigzag = [](uint64_t value) { return static_cast<int>(static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1)); };
+	view.tileSize = static_cast<int>(std::max<uint64_t>(1, std::min<uint64_t>(tileSize, 1 << 16)));
+	view.worldOffset = Point{ zigzag(x), zigzag(y) };
+	view.running = running == 1;
+	return true;
+}
+
+static std::vector<uint8_t> compressProject(const ProjectSnapshot &snapshot) {
+	ByteWriter file;
+	file.writeBytes(projectMagic, sizeof(projectMagic));
+	writeViewFields(snapshot.view, file);
+	writeSnapshotBlocks(snapshot, file);
+	return std::move(file.bytes);
+}
+
+double Circuit::saveProject(const std::string &path) {
+	auto start = std::chrono::high_resolution_clock::now();
+	saveProjectAsync(path);
+	waitForSaves();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+double Circuit::saveSnapshot(const std::string &path) {
+	auto start = std::chrono::high_resolution_clock::now();
+	queueSnapshot(path);
+	waitForSaves();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+double Circuit::saveProjectAsync(const std::string &path) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	journalMoves();
+	// The view and selection are not journaled as they change, only where they are at each save
+	std::string state = stateLines();
+	if (state != savedState) {
+		pendingEdits += state;
+		pendingLines += 2;
+	}
+
+	// Replaying a journal costs about as much as loading as many gates, so it is kept shorter than the project.
+	// Partially loaded projects have no journal since it could refer to gates that are not loaded
+	if (tiles || path != savedPath || journalFailed || simulatedSinceSave || journalLines + pendingLines > std::max<size_t>(4096, gates.size())) {
+		queueSnapshot(path);
+	}
+	else if (!pendingEdits.empty()) {
+		auto edits = std::make_shared<std::string>(std::move(pendingEdits));
+		writer.submit([this, path, edits]() {
+			if (!appendFile(journalPath(path), edits->data(), edits->size())) {
+				std::cout << "Could not append to " << journalPath(path) << "\n";
+				journalFailed = true;
+			}
+		});
+		journalLines += pendingLines;
+		pendingEdits.clear();
+		pendingLines = 0;
+		savedState = std::move(state);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+void Circuit::queueSnapshot(const std::string &path) {
+	if (tiles) {
+		// The chunks that are not loaded are copied from the file of the previous save, so it must be finished
+		finishTiledSave();
+		tiledSave = tiles->prepareSave(takeSnapshot(), path, Component::GUID);
+		writer.submit([path, save = tiledSave]() {
+			bool written = TiledProject::writeSave(*save);
+			save->done = true;
+			if (!written) {
+				std::cout << "Could not save " << path << "\n";
+				return;
+			}
+			std::remove(journalPath(path).c_str());
+		});
+	}
+	else {
+		queueWrite(path);
+	}
+
+	savedPath = path;
+	savedState = stateLines();
+	journalLines = 0;
+	journalFailed = false;
+	discardEdits();
+}
+std::string Circuit::stateLines() const {
+	std::string lines = "v" + formatView(view).substr(4) + "\ns";
+	for (size_t i = 0; i < gates.size(); i++) {
+		if (gates.isSelected(i)) {
+			lines += ',';
+			appendNumber(lines, static_cast<int64_t>(gates[i].id));
+		}
+	}
+	return lines + '\n';
+}
+void Circuit::waitForSaves() {
+	writer.wait();
+	finishTiledSave();
+}
+void Circuit::finishTiledSave() {
+	if (!tiledSave) { return; }
+
+	if (!tiledSave->done) {
+		writer.wait();
+	}
+	if (tiles) {
+		tiles->finishSave(*tiledSave);
+	}
+	tiledSave.reset();
+}
+void Circuit::queueWrite(const std::string &path) {
+	// Only the copy is made here, formatting and writing happen on the writer thread
+	auto snapshot = std::make_shared<const ProjectSnapshot>(takeSnapshot());
+	ProjectFormat format = projectFormat;
+	uint64_t nextId = Component::GUID;
+	writer.submit([path, snapshot, format, nextId]() {
+		bool written;
+		if (format == ProjectFormat::COMPRESSED) {
+			written = writeFileAtomic(path, compressProject(*snapshot));
+		}
+		else if (format == ProjectFormat::TILED) {
+			written = TiledProject::write(*snapshot, path, nextId);
+		}
+		else {
+			std::string text = formatProject(*snapshot);
+			written = writeFileAtomic(path, text.data(), text.size());
+		}
+		if (!written) {
+			std::cout << "Could not save " << path << "\n";
+			return;
+		}
+		// The project now has every edit of the journal
+		std::remove(journalPath(path).c_str());
+	});
+}
+// Reads a number followed by the end of the line or a comma and another field
+template<typename T>
+static bool parseField(const char *&first, const char *last, T &value) {
+	auto result = std::from_chars(first, last, value);
+	if (result.ec != std::errc()) { return false; }
+	first = result.ptr;
+	if (first != last) {
+		if (*first != ',') { return false; }
+		first++;
+		if (first == last) { return false; }
+	}
+	return true;
+}
+
+// Parses a "view,tile size,x,y,running" line
+static bool parseView(const char *first, const char *last, ProjectView &view) {
+	if (last - first < 5 || std::memcmp(first, "view,", 5) != 0) { return false; }
+	first += 5;
+	ProjectView parsed;
+	int running = 0;
+	if (!parseField(first, last, parsed.tileSize) || !parseField(first, last, parsed.worldOffset.x) || !parseField(first, last, parsed.worldOffset.y)
+		|| !parseField(first, last, running) || first != last || parsed.tileSize < 1) {
+		return false;
+	}
+	parsed.running = running != 0;
+	view = parsed;
+	return true;
+}
+
+// Parses the lines in [first, last) of one section of a text project, returns the number of malformed lines
+static size_t parseLines(const char *first, const char *last, bool connections, ProjectSnapshot &snapshot) {
+	size_t malformed = 0;
+	std::vector<Point> connectionPoints;
+	while (first < last) {
+		const char *end = static_cast<const char *>(std::memchr(first, '\n', last - first));
+		const char *next = end ? end + 1 : last;
+		end = end ? end : last;
+		if (end > first && end[-1] == '\r') { end--; }
+		if (first == end) {
+			first = next;
+			continue;
+		}
+
+		bool parsed;
+		if (!connections) {
+			ProjectSnapshot::Gate gate{};
+			int type = 0;
+			int output = 0;
+			int selected = 0;
+			parsed = parseField(first, end, gate.id) && parseField(first, end, type) && parseField(first, end, output)
+				&& parseField(first, end, gate.position.x) && parseField(first, end, gate.position.y)
+				&& (first == end || parseField(first, end, selected)) && (first == end || parseField(first, end, gate.counter))
+				&& first == end && type >= 0 && type <= static_cast<int>(GateType::TIMER);
+			gate.type = static_cast<GateType>(type);
+			gate.output = output != 0;
+			gate.selected = selected != 0;
+			if (parsed) { snapshot.gates.push_back(gate); }
+		}
+		else {
+			uint64_t dst = 0;
+			uint64_t src = 0;
+			int input = 0;
+			parsed = parseField(first, end, dst) && parseField(first, end, src) && parseField(first, end, input);
+			connectionPoints.clear();
+			while (parsed && first != end) {
+				Point point;
+				parsed = parseField(first, end, point.x) && first != end && parseField(first, end, point.y);
+				connectionPoints.push_back(point);
+			}
+			if (parsed) { snapshot.addConnection(dst, src, input, connectionPoints.data(), connectionPoints.size()); }
+		}
+		malformed += !parsed;
+		first = next;
+	}
+	return malformed;
+}
+
+// Runs the function for [0, count) with one thread per index
+static void parallelFor(size_t count, const std::function<void(size_t)> &function) {
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < count; i++) {
+		threads.emplace_back(function, i);
+	}
+	if (count > 0) {
+		function(0);
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+// Splits [first, last) into count ranges that start at a line
+static std::vector<const char *> splitLines(const char *first, const char *last, size_t count) {
+	std::vector<const char *> bounds{ first };
+	for (size_t i = 1; i < count; i++) {
+		const char *bound = std::max(bounds.back(), first + (last - first) * i / count);
+		const char *end = static_cast<const char *>(std::memchr(bound, '\n', last - bound));
+		bounds.push_back(end ? end + 1 : last);
+	}
+	bounds.push_back(last);
+	return bounds;
+}
+
+void Circuit::loadText(const std::vector<uint8_t> &bytes, ProjectView &view) {
+	const char *first = reinterpret_cast<const char *>(bytes.data());
+	const char *last = first + bytes.size();
+
+	// Projects saved before the view was saved start with the gates
+	const char *lineEnd = static_cast<const char *>(std::memchr(first, '\n', last - first));
+	lineEnd = lineEnd ? lineEnd : last;
+	if (parseView(first, lineEnd > first && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd, view)) {
+		first = lineEnd == last ? last : lineEnd + 1;
+	}
+
+	// Gates end at the first line starting with "-", lines of gates start with their id
+	const char *separator = first;
+	while (separator < last && *separator != '-') {
+		const char *end = static_cast<const char *>(std::memchr(separator, '\n', last - separator));
+		separator = end ? end + 1 : last;
+	}
+	const char *connectionsStart = separator;
+	if (separator < last) {
+		const char *end = static_cast<const char *>(std::memchr(separator, '\n', last - separator));
+		connectionsStart = end ? end + 1 : last;
+	}
+
+	// Both sections are parsed in ranges of lines of about a megabyte, one thread per range
+	size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	auto gateBounds = splitLines(first, separator, std::min<size_t>(threadCount, (separator - first) / (1 << 20) + 1));
+	auto connectionBounds = splitLines(connectionsStart, last, std::min<size_t>(threadCount, (last - connectionsStart) / (1 << 20) + 1));
+	size_t gateRanges = gateBounds.size() - 1;
+	size_t connectionRanges = connectionBounds.size() - 1;
+	std::vector<ProjectSnapshot> parts(gateRanges + connectionRanges);
+	std::vector<size_t> malformed(parts.size());
+	parallelFor(parts.size(), [&](size_t i) {
+		bool connections = i >= gateRanges;
+		auto &bounds = connections ? connectionBounds : gateBounds;
+		size_t range = connections ? i - gateRanges : i;
+		malformed[i] = parseLines(bounds[range], bounds[range + 1], connections, parts[i]);
+	});
+
+	size_t gateCount = 0;
+	size_t pointCount = 0;
+	for (auto &part : parts) {
+		gateCount += part.gates.size();
+		pointCount += part.points.size();
+	}
+	gates.reserve(gates.size() + gateCount, pointCount);
+
+	// Gates are created in the order of the file, the store is not shared between threads
+	for (size_t i = 0; i < gateRanges; i++) {
+		for (auto &gate : parts[i].gates) {
+			createGate(gates, gate);
+		}
+	}
+
+	// Gates are not stored in id order since removing a gate moves the last gate into its place,
+	// so connections find their gates by binary search in the ids sorted with their dense index
+	std::vector<std::pair<uint64_t, uint32_t>> ids(gates.size());
+	for (size_t i = 0; i < gates.size(); i++) {
+		ids[i] = { gates[i].id, static_cast<uint32_t>(i) };
+		Component::GUID = std::max(Component::GUID, gates[i].id + 1);
+	}
+	std::sort(ids.begin(), ids.end());
+	auto find = [&](uint64_t id) {
+		auto it = std::lower_bound(ids.begin(), ids.end(), std::make_pair(id, uint32_t(0)));
+		return it != ids.end() && it->first == id ? it->second : SimulationEngine::noGate;
+	};
+
+	// Links are looked up in parallel, only connecting changes the store
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> links(connectionRanges);
+	parallelFor(connectionRanges, [&](size_t i) {
+		for (auto &connection : parts[gateRanges + i].connections) {
+			links[i].push_back({ find(connection.src), find(connection.dst) });
+		}
+	});
+
+	size_t missing = 0;
+	std::vector<Point> connectionPoints;
+	for (size_t i = 0; i < connectionRanges; i++) {
+		auto &part = parts[gateRanges + i];
+		for (size_t j = 0; j < part.connections.size(); j++) {
+			auto link = links[i][j];
+			if (link.first == SimulationEngine::noGate || link.second == SimulationEngine::noGate) {
+				missing++;
+				continue;
+			}
+			auto &connection = part.connections[j];
+			connectionPoints.assign(part.points.begin() + connection.pointOffset, part.points.begin() + connection.pointOffset + connection.pointCount);
+			gates.connect(gates.handleAt(link.first), gates.handleAt(link.second), connection.input, connectionPoints);
+		}
+	}
+
+	size_t malformedLines = 0;
+	for (size_t count : malformed) {
+		malformedLines += count;
+	}
+	if (malformedLines > 0) {
+		std::cout << "Wrong structure in save file, skipped " << malformedLines << " lines\n";
+	}
+	if (missing > 0) {
+		std::cout << "Gate not found when loading " << missing << " connections\n";
+	}
+}
+double Circuit::loadProject(const std::string &path) {
+	auto start = std::chrono::high_resolution_clock::now();
+	// The project may still be being written
+	waitForSaves();
+
+	std::ifstream saveFile(path, std::ios::binary);
+	if (!saveFile.is_open()) { return -1; }
+
+	bool wasEmpty = gates.empty();
+	char magic[sizeof(projectMagic)] = {};
+	bool compressed = saveFile.read(magic, sizeof(magic)) && std::memcmp(magic, projectMagic, sizeof(magic)) == 0;
+	if (!compressed) {
+		saveFile.clear();
+		saveFile.seekg(0);
+	}
+	bool tiled = !compressed && TiledProject::isTiled(saveFile);
+	// The view of the file only replaces the circuit's when the circuit was empty
+	ProjectView loadedView = view;
+	if (compressed || tiled) {
+		bool loaded = compressed ? readViewFields(saveFile, loadedView) && loadCompressed(saveFile) : TiledProject::loadAll(saveFile, gates, loadedView);
+		if (!loaded) {
+			std::cout << "Wrong structure in save file\n";
+		}
+	}
+	else {
+		saveFile.close();
+		std::vector<uint8_t> bytes;
+		if (!readFile(path, bytes)) { return -1; }
+		loadText(bytes, loadedView);
+	}
+	journalLines = replayJournal(journalPath(path), loadedView);
+	if (wasEmpty) {
+		projectFormat = compressed ? ProjectFormat::COMPRESSED : tiled ? ProjectFormat::TILED : ProjectFormat::TEXT;
+		view = loadedView;
+	}
+
+	// Loading into a circuit with gates leaves a circuit that is only in memory, the next save writes all of it
+	savedPath = wasEmpty ? path : "";
+	savedState = stateLines();
+	discardEdits();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+bool loadSnapshotBlocks(std::istream &stream, GateStore &gates, std::unordered_map<uint64_t, GateHandle> &handles, ProjectSnapshot *unresolved) {
+	CompressedBlockReader blocks(stream);
+	ByteReader reader(nullptr, 0);
+	// Moves to the next block when the current one has no records left
+	auto nextRecord = [&]() {
+		while (reader.remaining() == 0) {
+			if (!blocks.next()) { return false; }
+			reader = ByteReader(blocks.data());
+		}
+		return true;
+	};
+
+	if (!nextRecord()) { return false; }
+	uint64_t gateCount = reader.readVarint();
+	if (!reader.ok()) { return false; }
+	handles.reserve(handles.size() + gateCount);
+	gates.reserve(gates.size() + gateCount);
+
+	uint64_t id = 0;
+	Point position{ 0, 0 };
+	for (uint64_t i = 0; i < gateCount; i++) {
+		if (!nextRecord()) { return false; }
+		id += reader.readSignedVarint();
+		uint8_t byte = reader.readByte();
+		position.x += static_cast<int>(reader.readSignedVarint());
+		position.y += static_cast<int>(reader.readSignedVarint());
+		auto type = static_cast<GateType>(byte & 0x3f);
+		int counter = type == GateType::TIMER ? static_cast<int>(reader.readSignedVarint()) : 0;
+		if (!reader.ok() || (byte & 0x3f) > static_cast<uint8_t>(GateType::TIMER)) { return false; }
+
+		handles[id] = createGate(gates, { id, type, (byte & 0x80) != 0, position, (byte & 0x40) != 0, counter });
+		Component::GUID = std::max(Component::GUID, id + 1);
+	}
+
+	if (!nextRecord()) { return false; }
+	uint64_t connectionCount = reader.readVarint();
+	uint64_t dstId = 0;
+	Point prev{ 0, 0 };
+	std::vector<Point> connectionPoints;
+	for (uint64_t i = 0; i < connectionCount; i++) {
+		if (!nextRecord()) { return false; }
+		dstId += reader.readSignedVarint();
+		uint64_t srcId = dstId + reader.readSignedVarint();
+		int input = reader.readByte();
+		uint64_t pointCount = reader.readVarint();
+		if (!reader.ok() || pointCount > reader.remaining()) { return false; }
+
+		connectionPoints.resize(pointCount);
+		for (auto &point : connectionPoints) {
+			point.x = prev.x + static_cast<int>(reader.readSignedVarint());
+			point.y = prev.y + static_cast<int>(reader.readSignedVarint());
+			prev = point;
+		}
+		if (!reader.ok()) { return false; }
+
+		auto src = handles.find(srcId);
+		auto dst = handles.find(dstId);
+		if (src != handles.end() && dst != handles.end()) {
+			gates.connect(src->second, dst->second, input, connectionPoints);
+		}
+		else if (unresolved) {
+			unresolved->addConnection(dstId, srcId, input, connectionPoints.data(), connectionPoints.size());
+		}
+		else {
+			std::cout << "Gate not found when loading connections\n";
+		}
+	}
+	return reader.ok() && reader.remaining() == 0;
+}
+double Circuit::openProject(const std::string &path, Point min, Point max) {
+	auto start = std::chrono::high_resolution_clock::now();
+	waitForSaves();
+
+	// The journal may refer to gates in any chunk, so a project with a journal is loaded whole
+	auto project = std::make_unique<TiledProject>();
+	if (!gates.empty() || std::ifstream(journalPath(path)).is_open() || !project->open(path)) {
+		return loadProject(path);
+	}
+	tiles = std::move(project);
+	tiles->showRegion(gates, min, max);
+
+	projectFormat = ProjectFormat::TILED;
+	view = tiles->getView();
+	savedPath = path;
+	savedState = stateLines();
+	journalLines = 0;
+	discardEdits();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+void Circuit::showRegion(Point min, Point max) {
+	if (!tiles) { return; }
+
+	// Only paging waits for a save that is still being written, since the file it reads chunks from is replaced
+	if (tiledSave && (tiledSave->done || tiles->pagesFor(min, max))) {
+		finishTiledSave();
+	}
+	tiles->showRegion(gates, min, max);
+}
+bool Circuit::isPartiallyLoaded() const {
+	return tiles != nullptr;
+}
+bool Circuit::loadCompressed(std::istream &stream) {
+	std::unordered_map<uint64_t, GateHandle> handles;
+	return loadSnapshotBlocks(stream, gates, handles);
+}
+size_t Circuit::replayJournal(const std::string &path, ProjectView &view) {
+	std::ifstream journal(path);
+	if (!journal.is_open()) { return 0; }
+
+	std::unordered_map<uint64_t, GateHandle> handles;
+	for (size_t i = 0; i < gates.size(); i++) {
+		handles[gates[i].id] = gates.handleAt(i);
+	}
+	auto find = [&](const std::string &id) {
+		auto it = handles.find(std::stoull(id));
+		return it == handles.end() ? GateHandle{} : it->second;
+	};
+
+	size_t lines = 0;
+	std::string line;
+	while (std::getline(journal, line)) {
+		std::stringstream ss(line);
+		std::string token;
+		std::vector<std::string> fields;
+		while (std::getline(ss, token, ',')) {
+			fields.push_back(token);
+		}
+		if (fields.empty()) { continue; }
+		lines++;
+
+		try {
+			const std::string &kind = fields[0];
+			if (kind == "p" && fields.size() == 6) {
+				uint64_t id = std::stoull(fields[1]);
+				// A journal left behind by an interrupted snapshot has gates that are already in the project
+				if (handles.count(id)) { continue; }
+				int type = std::stoi(fields[2]);
+				if (type < 0 || type > static_cast<int>(GateType::TIMER)) {
+					std::cout << "Wrong structure in journal line " << lines << "\n";
+					continue;
+				}
+
+				GateHandle gate = gates.create(static_cast<GateType>(type), Point{ std::stoi(fields[4]), std::stoi(fields[5]) }, id);
+				gates.setOutput(gate, fields[3] == "1");
+				handles[id] = gate;
+				Component::GUID = std::max(Component::GUID, id + 1);
+			}
+			else if (kind == "m" && fields.size() == 4) {
+				GateHandle gate = find(fields[1]);
+				if (gates.get(gate)) {
+					gates.setPosition(gate, Point{ std::stoi(fields[2]), std::stoi(fields[3]) });
+				}
+			}
+			else if (kind == "d" && fields.size() == 2) {
+				gates.remove(find(fields[1]));
+				handles.erase(std::stoull(fields[1]));
+			}
+			else if (kind == "c" && fields.size() >= 4 && fields.size() % 2 == 0) {
+				std::vector<Point> connectionPoints;
+				for (size_t i = 4; i < fields.size(); i += 2) {
+					connectionPoints.push_back({ std::stoi(fields[i]), std::stoi(fields[i + 1]) });
+				}
+				gates.connect(find(fields[2]), find(fields[1]), std::stoi(fields[3]), std::move(connectionPoints));
+			}
+			else if (kind == "o" && fields.size() == 3) {
+				gates.setOutput(find(fields[1]), fields[2] == "1");
+			}
+			else if (kind == "v" && fields.size() == 5) {
+				view.tileSize = std::max(1, std::stoi(fields[1]));
+				view.worldOffset = Point{ std::stoi(fields[2]), std::stoi(fields[3]) };
+				view.running = fields[4] == "1";
+			}
+			else if (kind == "s") {
+				gates.deselectAll();
+				for (size_t i = 1; i < fields.size(); i++) {
+					GateHandle gate = find(fields[i]);
+					if (gates.get(gate)) {
+						gates.select(gates.indexOf(gate));
+					}
+				}
+			}
+			else {
+				std::cout << "Wrong structure in journal line " << lines << "\n";
+			}
+		}
+		catch (const std::exception &) {
+			std::cout << "Wrong structure in journal line " << lines << "\n";
+		}
+	}
+	return lines;
+}
+bool readProjectView(const std::string &path, ProjectView &view) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) { return false; }
+
+	char magic[sizeof(projectMagic)] = {};
+	if (file.read(magic, sizeof(magic)) && std::memcmp(magic, projectMagic, sizeof(magic)) == 0) {
+		return readViewFields(file, view);
+	}
+	file.clear();
+	file.seekg(0);
+	if (TiledProject::isTiled(file)) {
+		TiledProject project;
+		if (!project.open(path)) { return false; }
+		view = project.getView();
+		return true;
+	}
+	file.clear();
+	file.seekg(0);
+	std::string line;
+	std::getline(file, line);
+	if (!line.empty() && line.back() == '\r') {
+		line.pop_back();
+	}
+	return parseView(line.data(), line.data() + line.size(), view);
+}
+Circuit::Circuit() = default;
+Circuit::~Circuit() = default;
+
+void Circuit::clear() {
+	gates.clear();
+	tiles.reset();
+	tiledSave.reset();
+	clipboard.clear();
+	savedPath.clear();
+	savedState.clear();
+	discardEdits();
+}
+
+/*
+ * Editing
+*/
+bool Circuit::checkCollision(GateHandle &outGate, Point point) {
+	GateHandle gate = gates.at(point);
+	if (gates.get(gate)) {
+		outGate = gate;
+		return true;
+	}
+
+	return false;
+}
+bool Circuit::placeGate(GateType type, Point point) {
+	GateHandle gate;
+	if (!checkCollision(gate, point)) {
+		journalGate(gates.create(type, point));
+		return true;
+	}
+	return false;
+}
+bool Circuit::connect(GateHandle src, GateHandle dst, int inputIndex, std::vector<Point> connectionPoints) {
+	if (src == dst) { return false; }
+
+	if (!gates.connect(src, dst, inputIndex, std::move(connectionPoints))) { return false; }
+
+	journalConnection(*gates.get(dst), inputIndex);
+	return true;
+}
+void Circuit::toggleComponent(Point point) {
+	GateHandle gate;
+	if (checkCollision(gate, point)) {
+		gates.setOutput(gate, !gates.output(gate));
+		journalLine("o," + std::to_string(gates.get(gate)->id) + "," + std::to_string(gates.output(gate)));
+	}
+}
+void Circuit::moveComponent(GateHandle gate, Point delta, bool moveConnections) {
+	Component *ptr = gates.get(gate);
+	if (!ptr || (delta.x == 0 && delta.y == 0)) { return; }
+	gates.setPosition(gate, ptr->position + delta);
+
+	auto [it, added] = movedIndices.try_emplace(ptr->id, movedGates.size());
+	if (added) {
+		movedGates.push_back({ gate, 0 });
+	}
+	if (moveConnections) {
+		// Move each point of the connection
+		for (size_t i = 0; i < ptr->inputs.size(); i++) {
+			auto &input = ptr->inputs[i];
+			if (gates.isSelected(input.src)) {
+				for (auto &point : gates.route(input)) {
+					point = point + delta;
+				}
+				movedGates[it->second].second |= 1u << i;
+			}
+		}
+	}
+}
+
+/*
+ * Copying and pasting
+ *
+ * The clipboard holds the copied gates as a snippet so that it can be shared through a file:
+ *   "LSC" and a version byte
+ *   varint gate count, then per gate a byte with the type and the output in the high bit
+ *   followed by the position relative to the previous gate, the first relative to the copy point
+ *   varint connection count, then per connection the varint clipboard index of the gate,
+ *   a byte with the input index, the varint clipboard index of the source and the varint point count
+ *   followed by the points relative to the previous point, the first relative to the copy point
+ * Positions are signed varints
+*/
+static const uint8_t snippetMagic[] = { 'L', 'S', 'C', 1 };
+
+static bool readSnippetHeader(ByteReader &reader) {
+	for (uint8_t byte : snippetMagic) {
+		if (reader.readByte() != byte) { return false; }
+	}
+	return true;
+}
+
+void Circuit::copySelected(Point point) {
+	if (gates.selectionSize() == 0) { return; }
+
+	ByteWriter snippet;
+	snippet.writeBytes(snippetMagic, sizeof(snippetMagic));
+	snippet.writeVarint(gates.selectionSize());
+
+	// Map the id of every copied gate to its index in the clipboard
+	std::unordered_map<uint64_t, int> clipboardIndices;
+	clipboardIndices.reserve(gates.selectionSize());
+
+	Point prev = point;
+	for (size_t i = 0; i < gates.size(); i++) {
+		if (gates.isSelected(i)) {
+			auto &gate = gates[i];
+			clipboardIndices[gate.id] = static_cast<int>(clipboardIndices.size());
+
+			snippet.writeByte(static_cast<uint8_t>(gate.getType()) | (gates.output(i) << 7));
+			snippet.writeSignedVarint(gate.position.x - prev.x);
+			snippet.writeSignedVarint(gate.position.y - prev.y);
+			prev = gate.position;
+		}
+	}
+
+	// Only connections where the input is also selected are copied
+	ByteWriter connections;
+	uint64_t connectionCount = 0;
+	for (size_t i = 0; i < gates.size(); i++) {
+		if (!gates.isSelected(i)) { continue; }
+
+		auto &gate = gates[i];
+		for (size_t input = 0; input < gate.inputs.size(); input++) {
+			auto &path = gate.inputs[input];
+			if (gates.isSelected(path.src)) {
+				connections.writeVarint(clipboardIndices[gate.id]);
+				connections.writeByte(static_cast<uint8_t>(input));
+				connections.writeVarint(clipboardIndices.at(gates.get(path.src)->id));
+				auto route = gates.route(path);
+				connections.writeVarint(route.size());
+
+				prev = point;
+				for (auto &pathPoint : route) {
+					connections.writeSignedVarint(pathPoint.x - prev.x);
+					connections.writeSignedVarint(pathPoint.y - prev.y);
+					prev = pathPoint;
+				}
+				connectionCount++;
+			}
+		}
+	}
+
+	snippet.writeVarint(connectionCount);
+	snippet.writeBytes(connections.bytes.data(), connections.bytes.size());
+	clipboard = std::move(snippet.bytes);
+}
+bool Circuit::pasteComponents(Point point) {
+	ByteReader reader(clipboard);
+	if (!readSnippetHeader(reader)) { return false; }
+
+	uint64_t gateCount = reader.readVarint();
+	if (!reader.ok() || gateCount > reader.remaining()) { return false; }
+	size_t gatesStart = reader.position();
+
+	deselectAll();
+
+	// Check for collisions on pasted positions
+	Point position = point;
+	for (uint64_t i = 0; i < gateCount; i++) {
+		uint8_t type = reader.readByte() & 0x7f;
+		position.x += static_cast<int>(reader.readSignedVarint());
+		position.y += static_cast<int>(reader.readSignedVarint());
+
+		GateHandle tmpGate;
+		if (type > static_cast<uint8_t>(GateType::TIMER) || checkCollision(tmpGate, position)) {
+			return false;
+		}
+	}
+	if (!reader.ok()) { return false; }
+
+	// Create the gates directly from the clipboard
+	size_t prevGateCount = gates.size();
+	gates.reserve(prevGateCount + gateCount);
+	reader.seek(gatesStart);
+	position = point;
+	for (uint64_t i = 0; i < gateCount; i++) {
+		uint8_t byte = reader.readByte();
+		position.x += static_cast<int>(reader.readSignedVarint());
+		position.y += static_cast<int>(reader.readSignedVarint());
+
+		GateHandle gate = gates.create(static_cast<GateType>(byte & 0x7f), position);
+		gates.setOutput(gate, byte >> 7);
+		journalGate(gate);
+
+		// Select each new instance of the gates
+		gates.select(gates.size() - 1);
+	}
+
+	// Connect the copied components to the inputs that were also copied
+	uint64_t connectionCount = reader.readVarint();
+	for (uint64_t i = 0; i < connectionCount && reader.ok(); i++) {
+		uint64_t dst = reader.readVarint();
+		int input = reader.readByte();
+		uint64_t src = reader.readVarint();
+		uint64_t pointCount = reader.readVarint();
+		if (!reader.ok() || pointCount > reader.remaining()) { break; }
+
+		std::vector<Point> connectionPoints(pointCount);
+		Point prev = point;
+		for (auto &pathPoint : connectionPoints) {
+			pathPoint.x = prev.x + static_cast<int>(reader.readSignedVarint());
+			pathPoint.y = prev.y + static_cast<int>(reader.readSignedVarint());
+			prev = pathPoint;
+		}
+
+		if (reader.ok() && dst < gateCount && src < gateCount
+			&& gates.connect(gates.handleAt(prevGateCount + src), gates.handleAt(prevGateCount + dst), input, std::move(connectionPoints))) {
+			journalConnection(gates[prevGateCount + dst], input);
+		}
+	}
+
+	return true;
+}
+bool Circuit::writeClipboard(const std::string &path) const {
+	return !clipboard.empty() && writeFileAtomic(path, clipboard);
+}
+bool Circuit::readClipboard(const std::string &path) {
+	std::vector<uint8_t> snippet;
+	if (!readFile(path, snippet)) { return false; }
+
+	ByteReader reader(snippet);
+	if (!readSnippetHeader(reader)) { return false; }
+
+	clipboard = std::move(snippet);
+	return true;
+}
+
+/*
+ * Removing
+*/
+void Circuit::removeComponent(Point point) {
+	GateHandle gate;
+	if (checkCollision(gate, point)) {
+		journalLine("d," + std::to_string(gates.get(gate)->id));
+		gates.remove(gate);
+	}
+}
+void Circuit::removeSelectedComponents() {
+	for (size_t i = 0; i < gates.size(); i++) {
+		if (gates.isSelected(i)) {
+			journalLine("d," + std::to_string(gates[i].id));
+		}
+	}
+	gates.removeSelected();
+}
+
+/*
+ * Selecting
+*/
+void Circuit::deselectAll() {
+	gates.deselectAll();
+}
+void Circuit::selectGatesInArea(Point corner1, Point corner2) {
+	Point min{ std::min(corner1.x, corner2.x), std::min(corner1.y, corner2.y) };
+	Point max{ std::max(corner1.x, corner2.x), std::max(corner1.y, corner2.y) };
+
+	for (size_t i = 0; i < gates.size(); i++) {
+		Point position = gates[i].position;
+		if (position.x < min.x || position.x > max.x) continue;
+		if (position.y < min.y || position.y > max.y) continue;
+
+		gates.select(i);
+	}
+}
+void Circuit::selectAllComponents() {
+	gates.selectAll();
+}
+void Circuit::toggleGateSelection(GateHandle gate) {
+	if (gates.get(gate)) {
+		gates.toggleSelection(gates.indexOf(gate));
+	}
+}
+
+/*
+ * Simulate the logic in the gates
+*/
+double Circuit::simulate(int steps) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	simulatedSinceSave |= steps > 0;
+	if (simulationMode == SimulationMode::BATCHED) {
+		engine.run(gates, steps);
+	}
+	else {
+		for (int i = 0; i < steps; i++) {
+			// Collect the outputs of each 64 gates in a word so that every word is written once
+			for (size_t first = 0; first < gates.size(); first += 64) {
+				size_t last = std::min(first + 64, gates.size());
+				uint64_t bits = 0;
+				for (size_t gate = first; gate < last; gate++) {
+					bits |= uint64_t(gates[gate].evaluate(gates, gates.output(gate))) << (gate - first);
+				}
+				gates.setNextOutputs(first / 64, bits);
+			}
+			gates.commitOutputs();
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
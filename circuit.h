@@ -0,0 +1,183 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "component.h"
+#include "engine.h"
+#include "gatestore.h"
+#include "serialization.h"
+
+enum class SimulationMode { INTERPRETED, BATCHED };
+// Compressed projects are binary and much smaller, tiled projects are compressed in chunks of the world that
+// can be loaded on their own. Loading recognizes every format
+enum class ProjectFormat { TEXT, COMPRESSED, TILED };
+
+// Editor state saved with a project, the editor copies its view in before saving and out after loading
+struct ProjectView {
+	int tileSize = 64;
+	Point worldOffset{ 0, 0 };
+	// Whether the simulation was running
+	bool running = false;
+};
+
+// Copy of everything a project file stores, cheap to take so it can be written while editing goes on
+struct ProjectSnapshot {
+	struct Gate {
+		uint64_t id;
+		GateType type;
+		bool output;
+		Point position;
+		bool selected;
+		// Steps counted by a TIMER
+		int counter;
+	};
+	struct Connection {
+		uint64_t dst;
+		uint64_t src;
+		int input;
+		// Range of the connection in points
+		uint32_t pointOffset;
+		uint32_t pointCount;
+	};
+
+	std::vector<Gate> gates;
+	std::vector<Connection> connections;
+	std::vector<Point> points;
+	ProjectView view;
+
+	void addConnection(uint64_t dst, uint64_t src, int input, const Point *route, size_t count) {
+		connections.push_back({ dst, src, input, static_cast<uint32_t>(points.size()), static_cast<uint32_t>(count) });
+		points.insert(points.end(), route, route + count);
+	}
+};
+
+// The gate at the dense index as a snapshot stores it
+ProjectSnapshot::Gate snapshotGate(const GateStore &gates, size_t dense);
+// The blocks of a compressed project after its view, see circuit.cpp
+void writeSnapshotBlocks(const ProjectSnapshot &snapshot, ByteWriter &out);
+// Adds the gates and connections of the blocks to the GateStore, connections are made between the gates in handles
+// and new gates are added to it. Connections to gates that are missing are kept in unresolved if it is given.
+// Returns false if the blocks are corrupt
+bool loadSnapshotBlocks(std::istream &stream, GateStore &gates, std::unordered_map<uint64_t, GateHandle> &handles, ProjectSnapshot *unresolved = nullptr);
+
+// The view in binary projects
+void writeViewFields(const ProjectView &view, ByteWriter &out);
+bool readViewFields(std::istream &stream, ProjectView &view);
+// Reads only the view saved at the start of a project file, so the editor can show the right place before loading
+bool readProjectView(const std::string &path, ProjectView &view);
+
+class TiledProject;
+struct TiledSave;
+
+/*
+ * The circuit being edited, independent of any GUI so that it can be driven by tools and benchmarks
+*/
+class Circuit {
+public:
+	GateStore gates;
+	// Copied gates in the compact snippet format described in circuit.cpp
+	std::vector<uint8_t> clipboard;
+	// Interpreted calls evaluate on every gate, batched runs the compiled SimulationEngine
+	SimulationMode simulationMode = SimulationMode::BATCHED;
+	SimulationEngine engine;
+	// Format of the whole project on save, the journal is always text. Loading a project into an empty circuit
+	// switches to the format of the file
+	ProjectFormat projectFormat = ProjectFormat::TEXT;
+	// Saved with the project along with the selection and the counters of the timers, and set from the file when
+	// a project is loaded into an empty circuit
+	ProjectView view;
+
+	// Returns the time taken in ms, loadProject returns a negative time if the file could not be opened.
+	// Saving appends the edits since the last save to the journal of the project and only writes the whole
+	// project when the journal has become long, loading replays the journal after reading the project
+	double saveProject(const std::string &path = "save.txt");
+	double loadProject(const std::string &path = "save.txt");
+	// Loads only the chunks of a tiled project around the region, other projects are loaded whole.
+	// Until the circuit is cleared, saving writes the loaded chunks back into the tiled project
+	double openProject(const std::string &path, Point min, Point max);
+	// Pages chunks of a project opened with openProject in and out to follow the region
+	void showRegion(Point min, Point max);
+	// Whether the circuit is a tiled project opened with openProject, simulating only covers the loaded gates
+	bool isPartiallyLoaded() const;
+	// Writes the whole project and removes its journal
+	double saveSnapshot(const std::string &path = "save.txt");
+	// Saves like saveProject but the file is written on a background thread, returns the time the caller waited.
+	// Files are replaced atomically, so a crash during the write leaves the previous save intact
+	double saveProjectAsync(const std::string &path = "save.txt");
+	// Returns once the background saves have been written
+	void waitForSaves();
+	ProjectSnapshot takeSnapshot() const;
+	void clear();
+
+	Circuit();
+	~Circuit();
+
+	bool checkCollision(GateHandle &outGate, Point point);
+	bool placeGate(GateType type, Point point);
+	bool connect(GateHandle src, GateHandle dst, int inputIndex, std::vector<Point> connectionPoints);
+	void toggleComponent(Point point);
+	void moveComponent(GateHandle gate, Point delta, bool moveConnections);
+
+	void copySelected(Point point);
+	bool pasteComponents(Point point);
+	// Share the clipboard with other instances of the editor through a file
+	bool writeClipboard(const std::string &path) const;
+	bool readClipboard(const std::string &path);
+
+	void removeComponent(Point point);
+	void removeSelectedComponents();
+
+	void deselectAll();
+	void selectGatesInArea(Point corner1, Point corner2);
+	void selectAllComponents();
+	void toggleGateSelection(GateHandle gate);
+
+	double simulate(int steps = 1);
+
+private:
+	// Edits since the last save as lines of the journal format described in circuit.cpp
+	std::string pendingEdits;
+	size_t pendingLines = 0;
+	// Gates moved since the last journal line and a bit per input whose route moved with them. Dragging moves
+	// the gates every frame, so their positions are only journaled once another edit is made or the project is saved
+	std::vector<std::pair<GateHandle, uint32_t>> movedGates;
+	std::unordered_map<uint64_t, size_t> movedIndices;
+	// Project file the circuit was last saved to or loaded from, empty if the edits are not relative to one
+	std::string savedPath;
+	size_t journalLines = 0;
+	// View and selection as journal lines at the last save, they are journaled again when they change
+	std::string savedState;
+	// Set by the background writer when a journal could not be appended, the next save writes the whole project
+	std::atomic<bool> journalFailed{ false };
+	// Simulating changes outputs and timer counters that are not journaled, the next save writes the whole project
+	bool simulatedSinceSave = false;
+
+	// Parses the gates and connections of a text project on several threads
+	void loadText(const std::vector<uint8_t> &bytes, ProjectView &view);
+	bool loadCompressed(std::istream &stream);
+	// Journaled view lines set view, selection lines the selection of the circuit
+	size_t replayJournal(const std::string &path, ProjectView &view);
+	void journalGate(GateHandle gate);
+	void journalConnection(const Component &dst, int input);
+	void journalLine(const std::string &line);
+	void journalMoves();
+	// Drops the edits that were not saved, after the whole project was saved or loaded
+	void discardEdits();
+	// The view and selection as "v" and "s" journal lines
+	std::string stateLines() const;
+	// Writes the whole project, or the loaded chunks of a partially loaded project
+	void queueSnapshot(const std::string &path);
+	void queueWrite(const std::string &path);
+	// The project opened with openProject while it is partially loaded
+	std::unique_ptr<TiledProject> tiles;
+	// Save of the partially loaded project being written, chunks are not paged until it is finished
+	std::shared_ptr<TiledSave> tiledSave;
+	// Waits for the save of the partially loaded project and reads the chunks that are not loaded from the new file
+	void finishTiledSave();
+
+	// Declared last so that it finishes writing before the rest of the circuit is destroyed
+	BackgroundWriter writer;
+};
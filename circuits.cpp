@@ -1,9 +1,11 @@
 #include <chrono>
+#include <filesystem>
 #include <string>
 #include <vector>
 #include <numeric>
 
-#include "component.h"
+#include "circuit.h"
+#include "truthtable.h"
 
 #define OLC_PGE_APPLICATION
 #include "olcPixelGameEngine.h"
@@ -11,27 +13,22 @@
 enum class State {PLACING_GATE, DRAGGING_CONNECTION, DRAGGING_GATES, SELECTING_AREA};
 enum class SimulationState {PAUSED, STEP, RUNNING};
 
-struct alignas(64) CopiedGate {
-	std::shared_ptr<Component> gate;
-	std::vector<int> inputIndices;
-};
-
 class CircuitGUI : public olc::PixelGameEngine {
 	State state = State::PLACING_GATE;
 	SimulationState simulationState = SimulationState::PAUSED;
 	GateType selectedType = GateType::WIRE;
 	int selectedInputIndex = 1;
 
-	std::vector<std::shared_ptr<Component>> gates;
-	std::vector<std::weak_ptr<Component>> selectedGates;
-	std::vector<CopiedGate> copiedGates;
-	std::weak_ptr<Component> clickedGate;
-	std::weak_ptr<Component> connectionSrcGate;
+	Circuit circuit;
+	GateHandle clickedGate;
+	GateHandle connectionSrcGate;
 	std::vector<Point> connectionPoints;
 
 	Point clickedPoint{ 0,0 };
 	Point clickedPixelPoint{ 0,0 };
-	Point copyPoint{ 0,0 };
+
+	// Copied gates are also written here so they can be pasted in another instance of the editor
+	const std::string clipboardPath = (std::filesystem::temp_directory_path() / "logic-sim-clipboard.bin").string();
 
 	int tileSize = 64;
 	const int simulationsPerFrame = 1;
@@ -40,198 +37,60 @@ class CircuitGUI : public olc::PixelGameEngine {
 	int worldOffsetX = 0;
 	int worldOffsetY = 0;
 	
-	std::chrono::steady_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
 
 	/*
 	 * Check the user input and perform the actions bound to the inputs
 	*/
-	// TODO: Save zoom and worldOffset
 	void saveProject() {
-		auto start = std::chrono::high_resolution_clock::now();
-		std::ofstream saveFile("save.txt");
-
-		// Save all gates
-		for (auto &gate : gates) {
-			saveFile << gate->id << "," << static_cast<int>(gate->getType()) << "," << gate->output << "," << gate->position.x << "," << gate->position.y << "\n";
-		}
-
-		saveFile << "-\n";
-
-		// Save all connections
-		for (auto &gate : gates) {
-			for (int i = 0; i < gate->inputs.size(); i++) {
-				if (auto input_ptr = gate->inputs[i].src.lock()) {
-					saveFile << gate->id << "," << input_ptr->id << "," << i;
-					for (auto &point : gate->inputs[i].points) {
-						saveFile << "," << point.x << "," << point.y;
-					}
-					saveFile << "\n";
-				}
-			}
-		}
-
-		auto end = std::chrono::high_resolution_clock::now();
-		auto time = std::chrono::duration<double, std::milli>(end - start).count();
-		std::cout << "Saved project in " << time << "ms\n";
-	}
-	bool loadGates(const std::string &line) {
-		bool done = false;
-
-		if (line.front() == '-') {
-			if (!gates.empty()) {
-				Component::GUID = gates.back()->id + 1;
-			}
-			done = true;
-		}
-		else {
-			std::stringstream ss(line);
-			std::string token;
-			std::vector<std::string> result;
-			while (std::getline(ss, token, ',')) {
-				result.push_back(token);
-			}
-
-			if (result.size() > 5) {
-				std::cout << "Wrong structure in save file\n";
-			}
-			else {
-				uint64_t id = std::stoull(result[0]);
-				auto type = static_cast<GateType>(std::stoi(result[1]));
-				auto output = static_cast<bool>(std::stoi(result[2]));
-				int x = std::stoi(result[3]);
-				int y = std::stoi(result[4]);
-
-				gates.push_back(createComponent(type, "Test", Point{x, y}, id));
-				gates.back()->output = output;
-			}
-		}
-
-		return done;
-	}
-	void loadConnections(const std::string &line) {
-		std::stringstream ss(line);
-		std::string token;
-		std::vector<std::string> result;
-		while (std::getline(ss, token, ',')) {
-			result.push_back(token);
-		}
-
-		uint64_t dstId = std::stoull(result[0]);
-		uint64_t srcId = std::stoull(result[1]);
-		int inputIndex = std::stoi(result[2]);
-
-		// TODO: Save srcGate since multiple inputs to the same 
-		// TODO: Search for the gates with binary search
-		std::shared_ptr<Component> srcGate;
-		std::shared_ptr<Component> dstGate;
-		bool srcFound = false;
-		bool dstFound = false;
-		for (auto it = gates.begin(); it != gates.end() && !(srcFound && dstFound); it++) {
-			if (!srcFound) {
-				if ((*it)->id == srcId) {
-					srcGate = *it;
-					srcFound = true;
-				}
-			}
-			if (!dstFound) {
-				if ((*it)->id == dstId) {
-					dstGate = *it;
-					dstFound = true;
-				}
-			}
-		}
-
-		if (!srcFound || !dstFound) {
-			std::cout << "Gate not found when loading connections\n";
-		}
-		else {
-			std::vector<Point> connectionPoints;
-			for (int i = 3; i < result.size(); i += 2) {
-				connectionPoints.push_back({ std::stoi(result[i]), std::stoi(result[i + 1]) });
-			}
-			dstGate->connectInput(srcGate, inputIndex, connectionPoints);
-		}
+		circuit.view = ProjectView{ tileSize, Point{ worldOffsetX, worldOffsetY }, simulationState == SimulationState::RUNNING };
+		// The file is written in the background, editing only waits for the copy of the circuit
+		double time = circuit.saveProjectAsync();
+		std::cout << "Saving project, editing paused for " << time << "ms\n";
 	}
 	void loadProject() {
-		auto start = std::chrono::high_resolution_clock::now();
-
-		std::ifstream saveFile("save.txt");
-		if (!saveFile.is_open()) { return; }
-
-		bool gatesDone = false;
-		std::string line;
-		while (std::getline(saveFile, line)) {
-			if (!gatesDone) {
-				gatesDone = loadGates(line);
-			}
-			else {
-				loadConnections(line);
-			}
+		// Projects loaded into an empty circuit bring back the view they were saved with. Tiled projects only
+		// load the chunks around the view, so the view is read before the gates
+		bool wasEmpty = circuit.gates.empty();
+		ProjectView view;
+		if (wasEmpty && readProjectView("save.txt", view)) {
+			setView(view);
 		}
-
-		auto end = std::chrono::high_resolution_clock::now();
-		auto time = std::chrono::duration<double, std::milli>(end - start).count();
-		std::cout << "Loaded project in " << time << "ms\n";
-	}
-
-	static std::shared_ptr<Component> createComponent(GateType type, const std::string &name, Point point) {
-		 switch (type) {
-		 case GateType::WIRE:
-			 return std::make_shared<WIRE>("Wire " + name, point);
-		 case GateType::AND:
-			 return std::make_shared<AND>("AND " + name, point);
-		 case GateType::OR:
-			 return std::make_shared<OR>("OR " + name, point);
-		 case GateType::XOR:
-			 return std::make_shared<XOR>("XOR " + name, point);
-		 case GateType::NOT:
-			 return std::make_shared<NOT>("NOT " + name, point);
-		 case GateType::INPUT:
-			 return std::make_shared<Input>("Input " + name, point);
-		 case GateType::TIMER:
-			 return std::make_shared<TIMER>("Timer " + name, point);
-		 }
-	 }
-	static std::shared_ptr<Component> createComponent(GateType type, const std::string &name, Point point, uint64_t id) {
-		 switch (type) {
-		 case GateType::WIRE:
-			 return std::make_shared<WIRE>("Wire " + name, point, id);
-		 case GateType::AND:
-			 return std::make_shared<AND>("AND " + name, point, id);
-		 case GateType::OR:
-			 return std::make_shared<OR>("OR " + name, point, id);
-		 case GateType::XOR:
-			 return std::make_shared<XOR>("XOR " + name, point, id);
-		 case GateType::NOT:
-			 return std::make_shared<NOT>("NOT " + name, point, id);
-		 case GateType::INPUT:
-			 return std::make_shared<Input>("Input " + name, point, id);
-		 case GateType::TIMER:
-			 return std::make_shared<TIMER>("Timer " + name, point, id);
-		 }
-	 }
-	bool checkCollision(std::weak_ptr<Component> &outGate, Point point) {
-		for (std::shared_ptr<Component> &gate : gates) {
-			if (point.x == gate->position.x && point.y == gate->position.y) {
-				outGate = gate;
-				return true;
+		Point min, max;
+		getVisibleArea(min, max);
+		double time = circuit.openProject("save.txt", min, max);
+		if (time >= 0) {
+			std::cout << "Loaded project in " << time << "ms\n";
+			if (wasEmpty) {
+				setView(circuit.view);
+				simulationState = circuit.view.running ? SimulationState::RUNNING : SimulationState::PAUSED;
 			}
 		}
-
-		return false;
 	}
-	Point getWorldMousePos() {
-		float x = (GetMouseX() + worldOffsetX - GetDrawTargetWidth() / 2);
-		float y = (GetMouseY() + worldOffsetY - GetDrawTargetHeight() / 2);
+	void setView(const ProjectView &view) {
+		tileSize = view.tileSize;
+		worldOffsetX = view.worldOffset.x;
+		worldOffsetY = view.worldOffset.y;
+	}
+	Point getWorldPos(int screenX, int screenY) {
+		float x = (screenX + worldOffsetX - GetDrawTargetWidth() / 2);
+		float y = (screenY + worldOffsetY - GetDrawTargetHeight() / 2);
 
 		x /= tileSize;
 		y /= tileSize;
 
-		x = std::floorf(x);
-		y = std::floorf(y);
+		x = std::floor(x);
+		y = std::floor(y);
 
 		return Point{ static_cast<int>(x), static_cast<int>(y) };
 	}
+	Point getWorldMousePos() {
+		return getWorldPos(GetMouseX(), GetMouseY());
+	}
+	void getVisibleArea(Point &min, Point &max) {
+		min = getWorldPos(0, 0);
+		max = getWorldPos(GetDrawTargetWidth(), GetDrawTargetHeight());
+	}
 
 	void handleUserInput() {
 		// Left mouse
@@ -259,6 +118,8 @@ class CircuitGUI : public olc::PixelGameEngine {
 
 		if (GetKey(olc::V).bPressed && GetKey(olc::CTRL).bHeld) { pasteComponents(); }
 
+		if (GetKey(olc::T).bPressed && GetKey(olc::CTRL).bHeld) { writeTruthTable(); }
+
 		// Based on state
 		if (state == State::DRAGGING_CONNECTION) { autoPan(); }
 		if (state == State::DRAGGING_GATES) { moveComponents(); }
@@ -302,8 +163,8 @@ class CircuitGUI : public olc::PixelGameEngine {
 	}
 	void mouseReleased() {
 		if (state == State::DRAGGING_CONNECTION) {
-			std::weak_ptr<Component> gate;
-			if (checkCollision(gate, getWorldMousePos())) {
+			GateHandle gate;
+			if (circuit.checkCollision(gate, getWorldMousePos())) {
 				stopDraggingConnection(gate);
 			}
 		}
@@ -321,7 +182,7 @@ class CircuitGUI : public olc::PixelGameEngine {
 		clickedPoint = getWorldMousePos();
 		clickedPixelPoint = Point{ GetMouseX(), GetMouseY() };
 
-		if (checkCollision(clickedGate, clickedPoint)) {
+		if (circuit.checkCollision(clickedGate, clickedPoint)) {
 			if (GetKey(olc::SHIFT).bHeld) {
 				startDraggingGate();
 			}
@@ -355,125 +216,46 @@ class CircuitGUI : public olc::PixelGameEngine {
 		}
 	}
 
-	void copyComponents() {
-		for (auto &selectedGate : selectedGates) {
-			if (!selectedGate.expired()) {
-				auto selectedPtr = selectedGate.lock();
-
-				// Create a new instance of the component
-				copiedGates.push_back({ createComponent(selectedPtr->getType(), "Tmp", selectedPtr->position, 0) });
-				copiedGates.back().gate->inputs = selectedPtr->inputs;
-				copiedGates.back().gate->output = selectedPtr->output;
-				copiedGates.back().inputIndices.resize(copiedGates.back().gate->inputs.size(), -1);
-			}
-		}
-	}
-	void copyConnections() {
-		// For each gate
-		for (auto &copiedGate : copiedGates) {
-			int inputIndex = 0;
-
-			// For each input
-			for (auto &inputGate : copiedGate.gate->inputs) {
-				if (!inputGate.src.expired()) {
-					auto inputPtr = inputGate.src.lock();
-
-					// If the input is also selected
-					if (inputPtr->selected) {
-						int inputSrcIndex = 0;
-
-						// Find the input in the selectedGates vector and store the index in the CopiedGate struct
-						for (auto &src : selectedGates) {
-							if (!src.expired()) {
-								if (src.lock()->id == inputPtr->id) {
-									copiedGate.inputIndices[inputIndex] = inputSrcIndex;
-									break;
-								}
-							}
-							inputSrcIndex++;
-						}
-					}
-				}
-				inputIndex++;
-			}
-		}
-	}
 	void copySelected() {
-		copyPoint = getWorldMousePos();
-		if (!selectedGates.empty()) { copiedGates.clear(); }
-		
-		copyComponents();
-		copyConnections();
+		circuit.copySelected(getWorldMousePos());
+		circuit.writeClipboard(clipboardPath);
 	}
 	void pasteComponents() {
-		Point delta = getWorldMousePos() - copyPoint;
-
-		// Deselect all selected gates
-		for (auto &gate : selectedGates) {
-			if (!gate.expired()) {
-				gate.lock()->selected = false;
-			}
+		circuit.readClipboard(clipboardPath);
+		if (!circuit.pasteComponents(getWorldMousePos())) {
+			std::cout << "Gate collision on paste\n";
 		}
-		selectedGates.clear();
-
-		// Check for collisions on pasted positions
-		for (auto &gate : copiedGates) {
-			std::weak_ptr<Component> tmpGate;
-			if (checkCollision(tmpGate, gate.gate->position + delta)) {
-				std::cout << "Gate collision on paste\n";
-				return;
-			}
-		}
-
-		int prevGateCount = gates.size();
-		// Create of a new instance of the component 
-		for (auto &gate : copiedGates) {
-			gates.push_back(createComponent(gate.gate->getType(), "Copied test", gate.gate->position + delta));
-			gates.back()->output = gate.gate->output;
+	}
 
-			// Select each new instance of the gates
-			gates.back()->selected = true;
-			selectedGates.push_back(gates.back());
+	// The truth table of the selected gates, compared with truthtable_reference.txt if there is one
+	void writeTruthTable() {
+		TruthTable table;
+		std::string error;
+		if (!extractTruthTable(circuit.gates, table, error)) {
+			std::cout << error << "\n";
+			return;
 		}
+		table.write("truthtable.txt");
+		std::cout << "Wrote truth table of " << table.inputIds.size() << " inputs and " << table.outputIds.size() << " outputs to truthtable.txt\n";
 
-		// Connect the copied components to the inputs that were also copied
-		for (int j = 0; j < copiedGates.size(); j++) {
-			for (int i = 0; i < copiedGates[j].inputIndices.size(); i++) {
-				if (copiedGates[j].inputIndices[i] >= 0) {
-					auto newConnectionPath = copiedGates[j].gate->inputs[i].points;
-					for (auto &point : newConnectionPath) {
-						point = point + delta;
-					}
-					gates[prevGateCount + j]->connectInput(gates[prevGateCount + copiedGates[j].inputIndices[i]], i, std::move(newConnectionPath));
-				}
-
+		TruthTable reference;
+		std::vector<size_t> rows;
+		uint64_t count = 0;
+		if (reference.read("truthtable_reference.txt")) {
+			if (!compareTruthTables(table, reference, rows, count, error)) {
+				std::cout << error << "\n";
+			}
+			else {
+				std::cout << count << " rows differ from truthtable_reference.txt\n";
 			}
 		}
 	}
 
 	void removeComponent() {
-		std::weak_ptr<Component> gate;
-		if (checkCollision(gate, getWorldMousePos())) {
-			// Remove it from gates and selected gates
-			gates.erase(std::find(gates.begin(), gates.end(), gate.lock()));
-			for (auto it = selectedGates.begin(); it != selectedGates.end(); it++) {
-				if ((*it).expired()) {
-					selectedGates.erase(it);
-					break;
-				}
-			}
-		}
+		circuit.removeComponent(getWorldMousePos());
 	}
 	void removeSelectedComponents() {
-		for (auto it = gates.begin(); it != gates.end();) {
-			if ((*it)->selected) {
-				it = gates.erase(it);
-			}
-			else {
-				it++;
-			}
-		}
-		selectedGates.clear();
+		circuit.removeSelectedComponents();
 	}
 
 	void startDraggingConnection() {
@@ -487,14 +269,9 @@ class CircuitGUI : public olc::PixelGameEngine {
 		state = State::SELECTING_AREA;
 	}
 
-	void stopDraggingConnection(std::weak_ptr<Component> &gate) {
-		auto ptr = gate.lock();
-		auto clickedPtr = connectionSrcGate.lock();
-
-		if (clickedPtr != ptr) {
-			//std::cout << "Connected " << clickedPtr->name << " to input " << selectedInputIndex - 1 << " of " << ptr->name << std::endl;
-			ptr->connectInput(clickedPtr, selectedInputIndex - 1, connectionPoints);
-		}
+	void stopDraggingConnection(GateHandle gate) {
+		//std::cout << "Connected " << circuit.gates.label(*circuit.gates.get(connectionSrcGate)) << " to input " << selectedInputIndex - 1 << " of " << circuit.gates.label(*circuit.gates.get(gate)) << std::endl;
+		circuit.connect(connectionSrcGate, gate, selectedInputIndex - 1, connectionPoints);
 		connectionPoints.clear();
 		state = State::PLACING_GATE;
 	}
@@ -504,12 +281,7 @@ class CircuitGUI : public olc::PixelGameEngine {
 	void stopSelectingArea() {
 		// Deselect previously selected gates if ctrl is held
 		if (!GetKey(olc::CTRL).bHeld) {
-			for (auto &gate : selectedGates) {
-				if (!gate.expired()) {
-					gate.lock()->selected = false;
-				}
-			}
-			selectedGates.clear();
+			circuit.deselectAll();
 		}
 
 		selectGatesInArea();
@@ -518,51 +290,13 @@ class CircuitGUI : public olc::PixelGameEngine {
 	}
 
 	void selectGatesInArea() {
-		Point worldMousePos = getWorldMousePos();
-		Point delta = worldMousePos - clickedPoint;
-
-		for (auto &gate : gates) {
-			if (delta.x < 0) {
-				if (gate->position.x > clickedPoint.x || gate->position.x < worldMousePos.x) continue;
-			}
-			else {
-				if (gate->position.x < clickedPoint.x || gate->position.x > worldMousePos.x) continue;
-			}
-
-			if (delta.y < 0) {
-				if (gate->position.y > clickedPoint.y || gate->position.y < worldMousePos.y) continue;
-			}
-			else {
-				if (gate->position.y < clickedPoint.y || gate->position.y > worldMousePos.y) continue;
-			}
-
-			selectedGates.push_back(gate);
-			gate->selected = true;
-		}
+		circuit.selectGatesInArea(clickedPoint, getWorldMousePos());
 	}
 	void selectAllComponents() {
-		for (auto &gate : gates) {
-			if (!gate->selected) {
-				selectedGates.push_back(gate);
-				gate->selected = true;
-			}
-		}
+		circuit.selectAllComponents();
 	}
 	void toggleGateSelection() {
-		auto ptr = clickedGate.lock();
-		if (!ptr->selected) {
-			selectedGates.push_back(clickedGate);
-			ptr->selected = true;
-		}
-		else {
-			for (auto it = selectedGates.begin(); it != selectedGates.end(); it++) {
-				if ((*it).lock()->id == ptr->id) {
-					selectedGates.erase(it);
-					break;
-				}
-			}
-			ptr->selected = false;
-		}
+		circuit.toggleGateSelection(clickedGate);
 	}
 
 	void addPointToConnectionPath() {
@@ -571,7 +305,7 @@ class CircuitGUI : public olc::PixelGameEngine {
 	Point getConnectionLine() {
 		Point src{ 0,0 };
 		if (connectionPoints.empty()) {
-			auto ptr = clickedGate.lock();
+			auto ptr = circuit.gates.get(clickedGate);
 			src = ptr->position;
 		}
 		else {
@@ -596,11 +330,7 @@ class CircuitGUI : public olc::PixelGameEngine {
 	}
 
 	void placeGate() {
-		std::weak_ptr<Component> gate;
-		if (!checkCollision(gate, getWorldMousePos())) {
-			gates.push_back(createComponent(selectedType, "Test", getWorldMousePos()));
-		}
-		else {
+		if (!circuit.placeGate(selectedType, getWorldMousePos())) {
 			std::cout << "Space already occupied by component\n";
 		}
 	}
@@ -625,67 +355,43 @@ class CircuitGUI : public olc::PixelGameEngine {
 		}
 	}
 
-	void moveComponent(std::shared_ptr<Component> &gate, Point delta) {
-		gate->position = gate->position + delta;
-
-		if (clickedGate.lock()->selected) {
-			// Move each point of the connection
-			for (auto &input : gate->inputs) {
-				if (auto srcPtr = input.src.lock()) {
-					if (srcPtr->selected) {
-						for (auto &point : input.points) {
-							point = point + delta;
-						}
-					}
-				}
-			}
-		}
-	}
 	void moveComponents() {
 		Point delta = getWorldMousePos() - clickedPoint;
 
-		std::weak_ptr<Component> tmpGate;
+		GateHandle tmpGate;
 		bool collision = false;
 
 		// Move all selected gates if the clicked gate was selected
-		if (clickedGate.lock()->selected) {
+		if (circuit.gates.isSelected(clickedGate)) {
 			// Check if any of the selected gates collide after move
-			for (auto &gate : selectedGates) {
-				if (auto ptr = gate.lock()) {
-					if (checkCollision(tmpGate, getWorldMousePos())) {
-						// If both colliding gates are selected then there is no collision after the move since both move
-						if (!tmpGate.lock()->selected) {
-							collision = true;
-							break;
-						}
-					}
+			if (circuit.checkCollision(tmpGate, getWorldMousePos())) {
+				// If both colliding gates are selected then there is no collision after the move since both move
+				if (!circuit.gates.isSelected(tmpGate)) {
+					collision = true;
 				}
 			}
 
 			// Move all selected gates if there was no collition
 			if (!collision) {
-				for (auto &gate : selectedGates) {
-					moveComponent(gate.lock(), delta);
+				for (size_t i = 0; i < circuit.gates.size(); i++) {
+					if (circuit.gates.isSelected(i)) {
+						circuit.moveComponent(circuit.gates.handleAt(i), delta, true);
+					}
 				}
 				clickedPoint = getWorldMousePos();
 			}
 		}
 		// Else just move the clicked component
 		else {
-			auto ptr = clickedGate.lock();
-			if (!checkCollision(tmpGate, getWorldMousePos())) {
-				moveComponent(ptr, delta);
+			if (!circuit.checkCollision(tmpGate, getWorldMousePos())) {
+				circuit.moveComponent(clickedGate, delta, false);
 				clickedPoint = getWorldMousePos();
 			}
 		}
 	}
 
 	void toggleComponent() {
-		std::weak_ptr<Component> gate;
-		if (checkCollision(gate, getWorldMousePos())) {
-			auto ptr = gate.lock();
-			ptr->output = !ptr->output;
-		}
+		circuit.toggleComponent(getWorldMousePos());
 	}
 
 	void zoom() {
@@ -703,26 +409,6 @@ class CircuitGUI : public olc::PixelGameEngine {
 		}
 	}
 
-	/*
-	 * Simulate the logic in the gates
-	*/
-	double simulate(int steps = 1) {
-		auto start = std::chrono::high_resolution_clock::now();
-
-		for (int i = 0; i < steps; i++) {
-			for (auto &gate : gates) {
-				gate->update();
-			}
-
-			for (auto &gate : gates) {
-				gate->output = gate->newOutput;
-			}
-		}
-
-		auto end = std::chrono::high_resolution_clock::now();
-		return std::chrono::duration<double, std::milli>(end - start).count();
-	}
-
 	/*
 	 * Draw the gates, connections and items related to the current action
 	*/
@@ -741,7 +427,8 @@ class CircuitGUI : public olc::PixelGameEngine {
 		return Point{ (point.x * tileSize) - worldOffsetX + GetDrawTargetWidth() / 2, (point.y * tileSize) - worldOffsetY + GetDrawTargetHeight() / 2 };
 	}
 	// TODO: Add culling
-	void drawConnectionPath(Point src, const Point &finalDst, const std::vector<Point> &points, olc::Pixel color) {
+	template<typename Points>
+	void drawConnectionPath(Point src, const Point &finalDst, const Points &points, olc::Pixel color) {
 		for (const auto &point : points) {
 			Point dst = getPixelPoint(point) + tileSize / 2;
 			DrawLine(src.x, src.y, dst.x, dst.y, color);
@@ -751,30 +438,31 @@ class CircuitGUI : public olc::PixelGameEngine {
 
 	}
 	void drawConnections() {
-		for (auto &gate : gates) {
+		for (auto &gate : circuit.gates) {
 			for (auto &input : gate->inputs) {
-				if (auto input_ptr = input.src.lock()) {
-					olc::Pixel color = input_ptr->output ? olc::RED : olc::BLACK;
-					drawConnectionPath(getPixelPoint(input_ptr->position) + tileSize / 2, getPixelPoint(gate->position) + tileSize / 2, input.points, color);
+				if (auto input_ptr = circuit.gates.get(input.src)) {
+					olc::Pixel color = circuit.gates.output(input.src) ? olc::RED : olc::BLACK;
+					drawConnectionPath(getPixelPoint(input_ptr->position) + tileSize / 2, getPixelPoint(gate->position) + tileSize / 2, circuit.gates.route(input), color);
 				}
 			}
 		}
 	}
 	void drawGates() {
-		for (auto &c : gates) {
+		for (size_t i = 0; i < circuit.gates.size(); i++) {
+			auto c = &circuit.gates[i];
 			Point position = getPixelPoint(c->position);
 
 			if (position.x >= -tileSize && position.x < GetDrawTargetWidth() && position.y >= -tileSize && position.y < GetDrawTargetHeight()) {
 
-				olc::Pixel color = c->output ? olc::RED : olc::GREY;
+				olc::Pixel color = circuit.gates.output(i) ? olc::RED : olc::GREY;
 				FillRect(position.x, position.y, tileSize, tileSize, color);
-				if (c->selected) {
+				if (circuit.gates.isSelected(i)) {
 					DrawRect(position.x, position.y, tileSize, tileSize, olc::BLACK);
 					DrawRect(position.x + 1, position.y + 1, tileSize - 2, tileSize - 2, olc::BLACK);
 				}
 
 				if (tileSize > 8) {
-					const std::string displayName = c->name.substr(0, c->name.find(' '));
+					const std::string displayName = circuit.gates.label(*c);
 					int xOffset = (displayName.size() / 2.0) * 8;
 					DrawString(position.x + tileSize / 2 - xOffset, position.y + tileSize / 2 - 4, displayName, olc::BLACK);
 				}
@@ -788,39 +476,17 @@ class CircuitGUI : public olc::PixelGameEngine {
 			// Constructing string with gate name if placing
 			case State::PLACING_GATE: {
 				stateString = "Placing ";
-				switch (selectedType) {
-				case GateType::WIRE:
-					stateString += "Wire";
-					break;
-				case GateType::AND:
-					stateString += "AND";
-					break;
-				case GateType::OR:
-					stateString += "OR";
-					break;
-				case GateType::XOR:
-					stateString += "XOR";
-					break;
-				case GateType::NOT:
-					stateString += "NOT";
-					break;
-				case GateType::INPUT:
-					stateString += "Input";
-					break;
-				case GateType::TIMER:
-					stateString += "Timer";
-					break;
-				}
+				stateString += gateTypeName(selectedType);
 				break;
 			}
 			// Drawing currently dragging connection
 			case State::DRAGGING_CONNECTION: {
-				auto ptr = connectionSrcGate.lock();
+				auto ptr = circuit.gates.get(connectionSrcGate);
 				
 				Point connectionLinePoint;
-				std::weak_ptr<Component> gate;
-				if (checkCollision(gate, getWorldMousePos())) {
-					connectionLinePoint = getPixelPoint(gate.lock()->position) + tileSize / 2;
+				GateHandle gate;
+				if (circuit.checkCollision(gate, getWorldMousePos())) {
+					connectionLinePoint = getPixelPoint(circuit.gates.get(gate)->position) + tileSize / 2;
 				}
 				else {
 					connectionLinePoint = getPixelPoint(getConnectionLine()) + tileSize / 2;
@@ -828,12 +494,12 @@ class CircuitGUI : public olc::PixelGameEngine {
 
 				drawConnectionPath(getPixelPoint(ptr->position) + tileSize / 2, connectionLinePoint, connectionPoints, olc::DARK_RED);
 
-				stateString = "Connecting " + ptr->name + " and input " + std::to_string(selectedInputIndex);
+				stateString = "Connecting " + circuit.gates.label(*ptr) + " and input " + std::to_string(selectedInputIndex);
 				break;
 			}
 			case State::DRAGGING_GATES: {
-				auto ptr = clickedGate.lock();
-				stateString = "Moving " + ptr->name;
+				auto ptr = circuit.gates.get(clickedGate);
+				stateString = "Moving " + circuit.gates.label(*ptr);
 				break;
 			}
 			// Drawing a rectangle for the currently selected area
@@ -893,13 +559,20 @@ public:
 		// User input
 		handleUserInput();
 
+		// Page the chunks of a partially loaded project in and out as the view moves
+		if (circuit.isPartiallyLoaded()) {
+			Point min, max;
+			getVisibleArea(min, max);
+			circuit.showRegion(min, max);
+		}
+
 		// Simulation update
 		double simulationTime = 0;
 		if (simulationState == SimulationState::RUNNING) {
-			simulationTime = simulate(simulationsPerFrame);
+			simulationTime = circuit.simulate(simulationsPerFrame);
 		}
 		else if (simulationState == SimulationState::STEP) {
-			simulationTime = simulate(1);
+			simulationTime = circuit.simulate(1);
 		}
 
 		// Drawing
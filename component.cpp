@@ -1,31 +1,94 @@
+#include <new>
+
 #include "component.h"
+#include "gatestore.h"
 
 uint64_t Component::GUID = 1;
 
+const char *gateTypeName(GateType type) {
+	switch (type) {
+	case GateType::WIRE:
+		return "Wire";
+	case GateType::AND:
+		return "AND";
+	case GateType::OR:
+		return "OR";
+	case GateType::XOR:
+		return "XOR";
+	case GateType::NOT:
+		return "NOT";
+	case GateType::INPUT:
+		return "Input";
+	case GateType::TIMER:
+		return "Timer";
+	}
+	return "";
+}
 
+bool initialOutput(GateType type) {
+	return type == GateType::NOT || type == GateType::INPUT;
+}
 
-Component::Component(std::string name, Point point, int numInputs, uint64_t id) : name(std::move(name)), position(point), id(id) {
+bool stepTimer(int &counter) {
+	if (counter < 15) {
+		counter++;
+		return false;
+	}
+	else if (counter < 30) {
+		counter++;
+		return true;
+	}
+	else {
+		counter = 0;
+		return false;
+	}
+}
+
+Component::Component(Point point, int numInputs, uint64_t id) : position(point), id(id) {
 	inputs.resize(numInputs);
 }
 
-void Component::connectInput(std::shared_ptr<Component> &component, int index, std::vector<Point> connectionPoints) {
-	if (index+1 > inputs.size()) {
-		std::cout << name << " only has " << inputs.size() << " number of inputs" << std::endl;
+bool Component::connectInput(GateHandle component, int index, uint32_t pointOffset, uint32_t pointCount) {
+	if (index < 0 || static_cast<size_t>(index) >= inputs.size()) {
+		std::cout << gateTypeName(getType()) << " only has " << inputs.size() << " number of inputs" << std::endl;
+		return false;
 	}
 	else {
 		inputs[index].src = component;
-		inputs[index].points = std::move(connectionPoints);
+		inputs[index].pointOffset = pointOffset;
+		inputs[index].pointCount = pointCount;
+		return true;
+	}
+}
+
+Component *createComponent(void *memory, GateType type, Point point, uint64_t id) {
+	switch (type) {
+	case GateType::WIRE:
+		return new (memory) WIRE(point, id);
+	case GateType::AND:
+		return new (memory) AND(point, id);
+	case GateType::OR:
+		return new (memory) OR(point, id);
+	case GateType::XOR:
+		return new (memory) XOR(point, id);
+	case GateType::NOT:
+		return new (memory) NOT(point, id);
+	case GateType::INPUT:
+		return new (memory) Input(point, id);
+	case GateType::TIMER:
+		return new (memory) TIMER(point, id);
 	}
+	return nullptr;
 }
 
 // Derived class constructors and methods
-AND::AND(std::string name, Point point, uint64_t id) : Component(std::move(name), point, 2, id) {}
-XOR::XOR(std::string name, Point point, uint64_t id) : Component(std::move(name), point, 2, id) {}
-OR::OR(std::string name, Point point, uint64_t id) : Component(std::move(name), point, 2, id) {}
-WIRE::WIRE(std::string name, Point point, uint64_t id) : Component(std::move(name), point, 1, id) {}
-NOT::NOT(std::string name, Point point, uint64_t id) : Component(std::move(name), point, 1, id) { output = true; newOutput = true; }
-Input::Input(std::string name, Point point, uint64_t id) : Component(std::move(name), point, 0, id) { output = true; newOutput = true; }
-TIMER::TIMER(std::string name, Point point, uint64_t id) : Component(std::move(name), point, 0, id) {}
+AND::AND(Point point, uint64_t id) : Component(point, 2, id) {}
+XOR::XOR(Point point, uint64_t id) : Component(point, 2, id) {}
+OR::OR(Point point, uint64_t id) : Component(point, 2, id) {}
+WIRE::WIRE(Point point, uint64_t id) : Component(point, 1, id) {}
+NOT::NOT(Point point, uint64_t id) : Component(point, 1, id) {}
+Input::Input(Point point, uint64_t id) : Component(point, 0, id) {}
+TIMER::TIMER(Point point, uint64_t id) : Component(point, 0, id) {}
 
 GateType AND::getType() { return GateType::AND; }
 GateType XOR::getType() { return GateType::XOR; }
@@ -35,83 +98,31 @@ GateType NOT::getType() { return GateType::NOT; }
 GateType Input::getType() { return GateType::INPUT; }
 GateType TIMER::getType() { return GateType::TIMER; }
 
-void AND::update() {
-	bool input1 = false;
-	bool input2 = false;
-
-	if (auto ptr = inputs[0].src.lock()) {
-		input1 = ptr->output;
-	}
-	if (auto ptr = inputs[1].src.lock()) {
-		input2 = ptr->output;
-	}
-
-	newOutput = input1 && input2;
+bool AND::evaluate(const GateStore &gates, bool) {
+	return gates.output(inputs[0].src) && gates.output(inputs[1].src);
 }
 
-void XOR::update() {
-	bool input1 = false;
-	bool input2 = false;
-
-	if (auto ptr = inputs[0].src.lock()) {
-		input1 = ptr->output;
-	}
-	if (auto ptr = inputs[1].src.lock()) {
-		input2 = ptr->output;
-	}
-
-	newOutput = input1 != input2;
+bool XOR::evaluate(const GateStore &gates, bool) {
+	return gates.output(inputs[0].src) != gates.output(inputs[1].src);
 }
 
-void OR::update() {
-	bool input1 = false;
-	bool input2 = false;
-
-	if (auto ptr = inputs[0].src.lock()) {
-		input1 = ptr->output;
-	}
-	if (auto ptr = inputs[1].src.lock()) {
-		input2 = ptr->output;
-	}
-
-	newOutput = input1 || input2;
+bool OR::evaluate(const GateStore &gates, bool) {
+	return gates.output(inputs[0].src) || gates.output(inputs[1].src);
 }
 
-void WIRE::update() {
-	bool input1 = false;
-
-	if (auto ptr = inputs[0].src.lock()) {
-		input1 = ptr->output;
-	}
-
-	newOutput = input1;
+bool WIRE::evaluate(const GateStore &gates, bool) {
+	return gates.output(inputs[0].src);
 }
 
-void NOT::update() {
-	bool input1 = false;
-
-	if (auto ptr = inputs[0].src.lock()) {
-		input1 = ptr->output;
-	}
-
-	newOutput = !input1;
+bool NOT::evaluate(const GateStore &gates, bool) {
+	return !gates.output(inputs[0].src);
 }
 
-void Input::update() {
-	newOutput = output;
+// Inputs are only changed by toggling them
+bool Input::evaluate(const GateStore &, bool output) {
+	return output;
 }
 
-void TIMER::update() {
-	if (counter < 15) {
-		newOutput = false;
-		counter++;
-	}
-	else if (counter < 30) {
-		newOutput = true;
-		counter++;
-	}
-	else {
-		counter = 0;
-		newOutput = false;
-	}
-}
\ No newline at end of file
+bool TIMER::evaluate(const GateStore &, bool) {
+	return stepTimer(counter);
+}
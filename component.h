@@ -1,13 +1,22 @@
 #pragma once
-#include <string>
 #include <vector>
 #include <iostream>
 #include <memory>
 #include <string_view>
+#include <cstdint>
+#include <algorithm>
 
 enum class GateType { AND, XOR, OR, WIRE, NOT, INPUT, TIMER };
 
+// Display name of the gate type, used as the label of gates that have not been named
+const char *gateTypeName(GateType type);
+// Output of a newly created gate
+bool initialOutput(GateType type);
+// Advances the counter of a timer and returns its output for the next step, off for 16 steps then on for 15
+bool stepTimer(int &counter);
+
 class Component;
+class GateStore;
 
 class Point {
 public:
@@ -31,76 +40,124 @@ inline Point operator+(const Point &u, const int v) {
 	return Point{ u.x + v, u.y + v };
 }
 
+// Stable reference to a gate in a GateStore, it stops resolving once the gate is removed
+struct GateHandle {
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+};
+
+inline bool operator==(const GateHandle &u, const GateHandle &v) {
+	return u.index == v.index && u.generation == v.generation;
+}
+
+inline bool operator!=(const GateHandle &u, const GateHandle &v) {
+	return !(u == v);
+}
+
+// Input of a gate that reads the output of another gate
+struct FanOut {
+	GateHandle dst;
+	int input = 0;
+};
+
+// The points of the path are stored in the route buffer of the GateStore.
+// The inputs reading the same gate form a linked list through next
 struct InputPath {
-	std::weak_ptr<Component> src;
-	std::vector<Point> points;
+	GateHandle src;
+	uint32_t pointOffset = 0;
+	uint32_t pointCount = 0;
+	FanOut next;
+};
+
+// Inputs are stored inline since no gate has more than two
+class Inputs {
+	InputPath paths[2];
+	uint8_t count = 0;
+
+public:
+	void resize(int size) { count = static_cast<uint8_t>(size); }
+	size_t size() const { return count; }
+	InputPath &operator[](size_t index) { return paths[index]; }
+	const InputPath &operator[](size_t index) const { return paths[index]; }
+	InputPath *begin() { return paths; }
+	InputPath *end() { return paths + count; }
+	const InputPath *begin() const { return paths; }
+	const InputPath *end() const { return paths + count; }
 };
 
 // Base class
 class Component {
 public:
-	std::string name;
+	// Index in the name table of the GateStore, 0 for gates without a name
+	uint32_t name = 0;
 	Point position;
-	bool output = false;
-	bool newOutput = false;
-	bool selected = false;
-	std::vector<InputPath> inputs;
+	Inputs inputs;
 	const uint64_t id;
 	static uint64_t GUID;
 
-	Component(std::string name, Point point, int numInputs, uint64_t id);
-	virtual void update() = 0;
+	Component(Point point, int numInputs, uint64_t id);
+	virtual ~Component() = default;
+	// Returns the output for the next step given the current output, the outputs are stored in the GateStore
+	virtual bool evaluate(const GateStore &gates, bool output) = 0;
 	virtual GateType getType() = 0;
-	void connectInput(std::shared_ptr<Component> &component, int index, std::vector<Point> connectionPoints);
+	bool connectInput(GateHandle component, int index, uint32_t pointOffset, uint32_t pointCount);
 };
 
 // Derived classes
 class AND : public Component {
-	void update() override;
+	bool evaluate(const GateStore &gates, bool output) override;
 	GateType getType() override;
 public:
-	AND(std::string name_, Point point, uint64_t id = Component::GUID++);
+	AND(Point point, uint64_t id = Component::GUID++);
 };
 
 class XOR : public Component {
-	void update() override;
+	bool evaluate(const GateStore &gates, bool output) override;
 	GateType getType() override;
 public:
-	XOR(std::string name_, Point point, uint64_t id = Component::GUID++);
+	XOR(Point point, uint64_t id = Component::GUID++);
 };
 
 class OR : public Component {
-	void update() override;
+	bool evaluate(const GateStore &gates, bool output) override;
 	GateType getType() override;
 public:
-	OR(std::string name_, Point point, uint64_t id = Component::GUID++);
+	OR(Point point, uint64_t id = Component::GUID++);
 };
 
 class WIRE : public Component {
-	void update() override;
+	bool evaluate(const GateStore &gates, bool output) override;
 	GateType getType() override;
 public:
-	WIRE(std::string name_, Point point, uint64_t id = Component::GUID++);
+	WIRE(Point point, uint64_t id = Component::GUID++);
 };
 
 class NOT : public Component {
-	void update() override;
+	bool evaluate(const GateStore &gates, bool output) override;
 	GateType getType() override;
 public:
-	NOT(std::string name_, Point point, uint64_t id = Component::GUID++);
+	NOT(Point point, uint64_t id = Component::GUID++);
 };
 
 class Input : public Component {
-	void update() override;
+	bool evaluate(const GateStore &gates, bool output) override;
 	GateType getType() override;
 public:
-	Input(std::string name_, Point point, uint64_t id = Component::GUID++);
+	Input(Point point, uint64_t id = Component::GUID++);
 };
 
 class TIMER : public Component {
 	int counter = 0;
-	void update() override;
+	bool evaluate(const GateStore &gates, bool output) override;
 	GateType getType() override;
 public:
-	TIMER(std::string name_, Point point, uint64_t id = Component::GUID++);
-};
\ No newline at end of file
+	TIMER(Point point, uint64_t id = Component::GUID++);
+	int getCounter() const { return counter; }
+	void setCounter(int value) { counter = value; }
+};
+
+// Size of the largest component, used for the blocks of pooled storage
+constexpr size_t componentSize = std::max({ sizeof(AND), sizeof(XOR), sizeof(OR), sizeof(WIRE), sizeof(NOT), sizeof(Input), sizeof(TIMER) });
+
+// Construct a component of the given type in memory of at least componentSize bytes
+Component *createComponent(void *memory, GateType type, Point point, uint64_t id);
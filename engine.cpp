@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "engine.h"
+#include "gatestore.h"
+
+namespace {
+
+// Waits until all threads have arrived, threads yield while waiting in case there are fewer cores than threads
+class SpinBarrier {
+	const int count;
+	std::atomic<int> waiting{ 0 };
+	std::atomic<int> generation{ 0 };
+
+public:
+	explicit SpinBarrier(int count) : count(count) {}
+
+	void wait() {
+		int current = generation.load(std::memory_order_acquire);
+		if (waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == count) {
+			waiting.store(0, std::memory_order_relaxed);
+			generation.fetch_add(1, std::memory_order_release);
+			return;
+		}
+		while (generation.load(std::memory_order_acquire) == current) {
+			std::this_thread::yield();
+		}
+	}
+};
+
+}
+
+void SimulationEngine::compile(const GateStore &gates) {
+	const GateType types[] = { GateType::AND, GateType::XOR, GateType::OR, GateType::WIRE, GateType::NOT, GateType::INPUT, GateType::TIMER };
+	const size_t typeCount = std::size(types);
+
+	std::vector<uint32_t> order(gates.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = static_cast<uint32_t>(i);
+	}
+	std::vector<uint32_t> connections = localityOrder || threadCount > 1 ? connectionOrder(gates) : order;
+	if (localityOrder) {
+		order = connections;
+	}
+	partitioning = partitionGates(gates, threadCount, connections);
+	size_t partCount = partitioning.partSizes.size();
+
+	std::vector<size_t> counts(partCount * typeCount, 0);
+	for (size_t i = 0; i < gates.size(); i++) {
+		counts[partitioning.parts[i] * typeCount + static_cast<int>(gates[i].getType())]++;
+	}
+
+	// Every batch is padded to whole words and every part to whole cache lines
+	std::vector<uint32_t> nextPositions(partCount * typeCount, 0);
+	uint32_t batchStart = 0;
+	timerCount = 0;
+	batches.clear();
+	partBatches.assign(1, 0);
+	partPositions.clear();
+	for (size_t part = 0; part < partCount; part++) {
+		batchStart = (batchStart + 511) / 512 * 512;
+		partPositions.push_back(batchStart);
+
+		for (GateType type : types) {
+			size_t key = part * typeCount + static_cast<int>(type);
+			if (counts[key] == 0) { continue; }
+
+			auto wordCount = static_cast<uint32_t>((counts[key] + 63) / 64);
+			batches.push_back({ type, batchStart / 64, wordCount, timerCount });
+			if (type == GateType::TIMER) {
+				timerCount += wordCount * 64;
+			}
+			nextPositions[key] = batchStart;
+			batchStart += wordCount * 64;
+		}
+		partBatches.push_back(static_cast<uint32_t>(batches.size()));
+	}
+	zeroBit = batchStart;
+	partPositions.push_back(zeroBit);
+
+	positions.assign(gates.size(), 0);
+	std::vector<uint32_t> indices(zeroBit, noGate);
+	for (uint32_t i : order) {
+		uint32_t &next = nextPositions[partitioning.parts[i] * typeCount + static_cast<int>(gates[i].getType())];
+		positions[i] = next;
+		indices[next] = i;
+		next++;
+	}
+
+	// One more word that stays zero for the unconnected inputs
+	size_t wordCount = zeroBit / 64 + 1;
+	denseIndices.allocate(zeroBit);
+	firstInputs.allocate(zeroBit);
+	secondInputs.allocate(zeroBit);
+	state.outputs.allocate(wordCount);
+	state.nextOutputs.allocate(wordCount);
+	state.outputs[wordCount - 1] = 0;
+	state.nextOutputs[wordCount - 1] = 0;
+	state.timerCounters.assign(timerCount, 0);
+
+	// The thread of each part fills its range first so the pages are placed on its node
+	forEachPart([&](size_t part) {
+		uint32_t begin = partPositions[part];
+		uint32_t end = partPositions[part + 1];
+		for (uint32_t position = begin; position < end; position++) {
+			denseIndices[position] = indices[position];
+			firstInputs[position] = zeroBit;
+			secondInputs[position] = zeroBit;
+			if (indices[position] == noGate) { continue; }
+
+			auto &inputs = gates[indices[position]].inputs;
+			for (size_t input = 0; input < inputs.size(); input++) {
+				if (gates.get(inputs[input].src)) {
+					(input == 0 ? firstInputs : secondInputs)[position] = positions[gates.indexOf(inputs[input].src)];
+				}
+			}
+		}
+		std::fill(state.outputs.data() + begin / 64, state.outputs.data() + end / 64, 0);
+		std::fill(state.nextOutputs.data() + begin / 64, state.nextOutputs.data() + end / 64, 0);
+	});
+	storedOutputs.allocate(wordCount);
+	stateSynced = false;
+	compiledRevision = gates.revision();
+}
+
+void SimulationEngine::evaluatePart(size_t part, const uint64_t *current, uint64_t *next, int *timerCounters) const {
+	const uint32_t *first = firstInputs.data();
+	const uint32_t *second = secondInputs.data();
+
+	for (uint32_t i = partBatches[part]; i < partBatches[part + 1]; i++) {
+		const Batch &batch = batches[i];
+		switch (batch.type) {
+		case GateType::AND:
+		case GateType::XOR:
+		case GateType::OR:
+		case GateType::WIRE:
+		case GateType::NOT:
+			kernels[static_cast<int>(batch.type)](current, next, first, second, batch.firstWord, batch.wordCount);
+			break;
+		case GateType::INPUT:
+			std::copy(current + batch.firstWord, current + batch.firstWord + batch.wordCount, next + batch.firstWord);
+			break;
+		case GateType::TIMER:
+			// There are too few timers to need a kernel
+			for (uint32_t word = batch.firstWord; word < batch.firstWord + batch.wordCount; word++) {
+				uint64_t bits = 0;
+				for (int bit = 0; bit < 64; bit++) {
+					uint32_t position = word * 64 + bit;
+					if (denseIndices[position] != noGate) {
+						bits |= uint64_t(stepTimer(timerCounters[batch.firstTimer + position - batch.firstWord * 64])) << bit;
+					}
+				}
+				next[word] = bits;
+			}
+			break;
+		}
+	}
+}
+
+void PartThreads::start(size_t partCount, std::function<void(size_t part)> setup) {
+	stop();
+	std::lock_guard<std::mutex> lock(mutex);
+	stopping = false;
+	for (size_t part = 0; part < partCount; part++) {
+		threads.emplace_back([this, part, setup, seen = generation]() { work(part, setup, seen); });
+	}
+}
+
+void PartThreads::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+}
+
+void PartThreads::work(size_t part, const std::function<void(size_t part)> &setup, uint64_t seen) {
+	setup(part);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		changed.wait(lock, [&]() { return stopping || generation != seen; });
+		if (stopping) { return; }
+
+		seen = generation;
+		lock.unlock();
+		(*job)(part);
+		lock.lock();
+		if (--running == 0) {
+			changed.notify_all();
+		}
+	}
+}
+
+void PartThreads::run(const std::function<void(size_t part)> &function) {
+	std::unique_lock<std::mutex> lock(mutex);
+	job = &function;
+	running = threads.size();
+	generation++;
+	changed.notify_all();
+	changed.wait(lock, [&]() { return running == 0; });
+	job = nullptr;
+}
+
+void SimulationEngine::forEachPart(const std::function<void(size_t part)> &function) {
+	size_t partCount = partPositions.size() - 1;
+	if (partCount == 1) {
+		function(0);
+		return;
+	}
+
+	// The threads are pinned when they start, so they are started again when the parts or nodes change
+	if (partThreads.size() != partCount) {
+		partThreads.start(partCount, [this](size_t part) {
+			if (numaNodes > 0) {
+				pinThreadToNode(topology, nodeOfPart(part));
+			}
+		});
+	}
+	partThreads.run(function);
+}
+
+size_t SimulationEngine::nodeOfPart(size_t part) const {
+	size_t partCount = std::max<size_t>(1, partPositions.size() - 1);
+	return part * numaNodes / partCount;
+}
+
+void SimulationEngine::setKernelSet(KernelSet set) {
+	// Never use instructions the cpu does not have
+	kernelSet = std::min(set, detectKernelSet());
+	for (GateType type : { GateType::AND, GateType::XOR, GateType::OR, GateType::WIRE, GateType::NOT, GateType::INPUT, GateType::TIMER }) {
+		kernels[static_cast<int>(type)] = batchKernel(kernelSet, type);
+	}
+}
+
+void SimulationEngine::setLocalityOrder(bool enabled) {
+	localityOrder = enabled;
+	compiledRevision = UINT64_MAX;
+}
+
+void SimulationEngine::setThreadCount(int count) {
+	threadCount = std::max(1, count);
+	compiledRevision = UINT64_MAX;
+	partThreads.stop();
+}
+
+void SimulationEngine::setNumaNodes(size_t count) {
+	numaNodes = std::min(count, topology.nodeCount());
+	compiledRevision = UINT64_MAX;
+	partThreads.stop();
+}
+
+void SimulationEngine::prepare(const GateStore &gates) {
+	if (compiledRevision != gates.revision()) {
+		compile(gates);
+	}
+}
+
+void SimulationEngine::loadState(const GateStore &gates, EngineState &state) const {
+	for (size_t dense = 0; dense < gates.size(); dense++) {
+		setOutput(state, dense, gates.output(dense));
+	}
+	for (const Batch &batch : batches) {
+		if (batch.type != GateType::TIMER) { continue; }
+
+		for (uint32_t position = batch.firstWord * 64; position < (batch.firstWord + batch.wordCount) * 64; position++) {
+			if (denseIndices[position] != noGate) {
+				auto &timer = static_cast<const TIMER &>(gates[denseIndices[position]]);
+				state.timerCounters[batch.firstTimer + position - batch.firstWord * 64] = timer.getCounter();
+			}
+		}
+	}
+}
+
+void SimulationEngine::initState(const GateStore &gates, EngineState &state) const {
+	size_t wordCount = zeroBit / 64 + 1;
+	state.outputs.allocate(wordCount);
+	state.nextOutputs.allocate(wordCount);
+	std::fill(state.outputs.data(), state.outputs.data() + wordCount, 0);
+	std::fill(state.nextOutputs.data(), state.nextOutputs.data() + wordCount, 0);
+	state.timerCounters.assign(timerCount, 0);
+	loadState(gates, state);
+}
+
+void SimulationEngine::runState(EngineState &state, int steps) const {
+	uint64_t *buffers[] = { state.outputs.data(), state.nextOutputs.data() };
+	for (int i = 0; i < steps; i++) {
+		for (size_t part = 0; part + 1 < partBatches.size(); part++) {
+			evaluatePart(part, buffers[i % 2], buffers[(i + 1) % 2], state.timerCounters.data());
+		}
+	}
+	if (steps % 2 == 1) {
+		state.outputs.swap(state.nextOutputs);
+	}
+}
+
+bool SimulationEngine::output(const EngineState &state, size_t dense) const {
+	uint32_t position = positions[dense];
+	return (state.outputs[position / 64] >> (position % 64)) & 1;
+}
+
+void SimulationEngine::setOutput(EngineState &state, size_t dense, bool value) const {
+	uint32_t position = positions[dense];
+	uint64_t mask = uint64_t(1) << (position % 64);
+	state.outputs[position / 64] = value ? state.outputs[position / 64] | mask : state.outputs[position / 64] & ~mask;
+}
+
+void SimulationEngine::syncState(GateStore &gates) {
+	if (!stateSynced || gates.everyOutputChanged()) {
+		loadState(gates, state);
+		stateSynced = true;
+	}
+	else {
+		for (uint32_t dense : gates.outputChanges()) {
+			setOutput(state, dense, gates.output(dense));
+		}
+	}
+	std::copy(state.outputs.data(), state.outputs.data() + zeroBit / 64 + 1, storedOutputs.data());
+	gates.markOutputsSynced();
+}
+
+void SimulationEngine::storeState(GateStore &gates) {
+	for (size_t word = 0; word < zeroBit / 64; word++) {
+		for (uint64_t changed = state.outputs[word] ^ storedOutputs[word]; changed != 0; changed &= changed - 1) {
+			uint32_t position = static_cast<uint32_t>(word * 64 + __builtin_ctzll(changed));
+			// The padding at the end of batches is evaluated too but has no gate
+			if (denseIndices[position] != noGate) {
+				gates.setOutput(denseIndices[position], (state.outputs[word] >> (position % 64)) & 1);
+			}
+		}
+	}
+	// There are too few timers to look for the counters that changed
+	for (const Batch &batch : batches) {
+		if (batch.type != GateType::TIMER) { continue; }
+
+		for (uint32_t position = batch.firstWord * 64; position < (batch.firstWord + batch.wordCount) * 64; position++) {
+			if (denseIndices[position] != noGate) {
+				auto &timer = static_cast<TIMER &>(gates[denseIndices[position]]);
+				timer.setCounter(state.timerCounters[batch.firstTimer + position - batch.firstWord * 64]);
+			}
+		}
+	}
+	gates.markOutputsSynced();
+}
+
+void SimulationEngine::run(GateStore &gates, int steps) {
+	prepare(gates);
+	// Outputs can be changed in the editor between runs, such as toggling an input
+	syncState(gates);
+
+	// Steps alternate between the two buffers and every thread finishes a step before the next one starts
+	uint64_t *buffers[] = { state.outputs.data(), state.nextOutputs.data() };
+	size_t partCount = partBatches.size() - 1;
+	auto simulatePart = [&](size_t part, SpinBarrier *barrier) {
+		for (int i = 0; i < steps; i++) {
+			evaluatePart(part, buffers[i % 2], buffers[(i + 1) % 2], state.timerCounters.data());
+			if (barrier) { barrier->wait(); }
+		}
+	};
+
+	SpinBarrier barrier(static_cast<int>(partCount));
+	forEachPart([&](size_t part) {
+		simulatePart(part, partCount == 1 ? nullptr : &barrier);
+	});
+	if (steps % 2 == 1) {
+		state.outputs.swap(state.nextOutputs);
+	}
+	storeState(gates);
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "component.h"
+#include "kernels.h"
+#include "numa.h"
+#include "partition.h"
+
+class GateStore;
+
+// Outputs and timer counters of one simulation of a compiled circuit
+struct EngineState {
+	// One bit per position
+	FirstTouchArray<uint64_t> outputs;
+	FirstTouchArray<uint64_t> nextOutputs;
+	std::vector<int> timerCounters;
+};
+
+// Threads that run a function for every part at once, a thread per part. They are started by the first run
+// and wait for the next one, so a run of a few steps does not pay for starting threads
+class PartThreads {
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable changed;
+	const std::function<void(size_t part)> *job = nullptr;
+	// Incremented for every run, each thread runs a job once
+	uint64_t generation = 0;
+	size_t running = 0;
+	bool stopping = false;
+
+	void work(size_t part, const std::function<void(size_t part)> &setup, uint64_t seen);
+
+public:
+	PartThreads() = default;
+	PartThreads(const PartThreads &) = delete;
+	PartThreads &operator=(const PartThreads &) = delete;
+	~PartThreads() { stop(); }
+
+	// Starts a thread per part that calls setup with its part before it waits for runs
+	void start(size_t partCount, std::function<void(size_t part)> setup);
+	void stop();
+	size_t size() const { return threads.size(); }
+	// Calls the function on the thread of every part and returns once all of them returned
+	void run(const std::function<void(size_t part)> &function);
+};
+
+/*
+ * Simulation of a GateStore compiled into batches of gates of the same type. Each batch is evaluated
+ * by a kernel specialized for its type, so the inner loops have no virtual calls or branches on the type.
+ * The kernels use the widest SIMD instructions the cpu supports unless a narrower set is chosen.
+ * Within each batch gates are placed in breadth-first order over their connections, so gates are near
+ * the gates they read and the gathered input words are more often already in cache.
+ * The engine keeps its own outputs in batch order, every batch starts on a word boundary so each word of
+ * outputs is written by one kernel. The circuit is compiled again whenever its structure changed.
+ *
+ * With more than one thread the gates are partitioned first and every thread evaluates the batches of
+ * its own part. Parts start on a cache line, so threads only share lines they read across the cut.
+ * Each part's thread is pinned to a NUMA node and is the first to write the part's arrays, so the arrays of a
+ * part are placed in the memory of the node that simulates it.
+ *
+ * The state run uses for the GateStore stays in the engine between runs. Only the outputs set in the GateStore
+ * since the last run are copied in, and only the outputs that changed are copied back, so a run of a single step
+ * costs little more than the step itself. The compiled circuit is not changed by simulating, so besides that state,
+ * any number of other states can be simulated at once on different threads with runState
+*/
+class SimulationEngine {
+	struct Batch {
+		GateType type;
+		uint32_t firstWord;
+		uint32_t wordCount;
+		// Index of the counter of the first position in timer batches
+		uint32_t firstTimer;
+	};
+
+	std::vector<Batch> batches;
+	// Batches of part i are [partBatches[i], partBatches[i + 1])
+	std::vector<uint32_t> partBatches;
+	// Positions of part i are [partPositions[i], partPositions[i + 1])
+	std::vector<uint32_t> partPositions;
+	Partitioning partitioning;
+	// Dense index in the GateStore of each position, noGate for the padding at the end of batches
+	FirstTouchArray<uint32_t> denseIndices;
+	// Positions of the gates read by each position, unconnected inputs read zeroBit which is always off
+	FirstTouchArray<uint32_t> firstInputs;
+	FirstTouchArray<uint32_t> secondInputs;
+	// Position of each gate by dense index
+	std::vector<uint32_t> positions;
+	uint32_t zeroBit = 0;
+	uint32_t timerCount = 0;
+
+	EngineState state;
+	// Outputs of the GateStore by position as of the end of the last run, to find the outputs a run changed
+	FirstTouchArray<uint64_t> storedOutputs;
+	// Whether state holds the outputs and timers of the GateStore apart from its outputChanges
+	bool stateSynced = false;
+	uint64_t compiledRevision = UINT64_MAX;
+
+	bool localityOrder = true;
+	int threadCount = 1;
+	NumaTopology topology = NumaTopology::detect();
+	size_t numaNodes = topology.nodeCount();
+	KernelSet kernelSet = KernelSet::SCALAR;
+	BatchKernel kernels[7] = {};
+	PartThreads partThreads;
+
+	void compile(const GateStore &gates);
+	void evaluatePart(size_t part, const uint64_t *current, uint64_t *next, int *timerCounters) const;
+	// Copies the outputs and timer counters of the GateStore into an allocated state
+	void loadState(const GateStore &gates, EngineState &state) const;
+	// Brings state up to date with the outputs set in the GateStore since the last run
+	void syncState(GateStore &gates);
+	// Copies the outputs and timer counters a run changed back into the GateStore
+	void storeState(GateStore &gates);
+	// Calls the function for every part, on one thread per part pinned to the part's node if there are several
+	void forEachPart(const std::function<void(size_t part)> &function);
+
+public:
+	static constexpr uint32_t noGate = UINT32_MAX;
+
+	SimulationEngine() { setKernelSet(detectKernelSet()); }
+
+	// Sets above what the cpu supports fall back to the widest supported set
+	void setKernelSet(KernelSet set);
+	KernelSet getKernelSet() const { return kernelSet; }
+	// Without the locality order gates keep the order of the GateStore within their batch
+	void setLocalityOrder(bool enabled);
+	// Number of parts simulated in parallel, 1 runs on the calling thread only
+	void setThreadCount(int count);
+	int getThreadCount() const { return threadCount; }
+	// Spreads the parts over the first count NUMA nodes, 0 leaves the threads unpinned so they may run on any node
+	void setNumaNodes(size_t count);
+	const NumaTopology &getTopology() const { return topology; }
+	// Node the thread of the part is pinned to, consecutive parts share a node
+	size_t nodeOfPart(size_t part) const;
+	// Parts of the last compiled circuit
+	const Partitioning &getPartitioning() const { return partitioning; }
+
+	// Runs the steps on the outputs of the GateStore and stores the results back
+	void run(GateStore &gates, int steps);
+
+	// Compiles the circuit if its structure changed since the last compile
+	void prepare(const GateStore &gates);
+	// A state of the prepared circuit starting from the outputs and timers of the GateStore
+	void initState(const GateStore &gates, EngineState &state) const;
+	// Runs the steps of every part on the calling thread, the GateStore is not changed
+	void runState(EngineState &state, int steps) const;
+	// Output of the gate with a dense index of the prepared circuit
+	bool output(const EngineState &state, size_t dense) const;
+	void setOutput(EngineState &state, size_t dense, bool value) const;
+};
@@ -0,0 +1,307 @@
+#include <algorithm>
+
+#include "gatestore.h"
+
+GateStore::~GateStore() {
+	for (Component *gate : dense) {
+		gate->~Component();
+	}
+}
+
+GateHandle GateStore::create(GateType type, Point point, uint64_t id) {
+	uint32_t slot;
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		slot = static_cast<uint32_t>(slots.size());
+		slots.push_back({ 0, 0 });
+	}
+
+	slots[slot].dense = static_cast<uint32_t>(dense.size());
+	dense.push_back(createComponent(pool.allocate(), type, point, id));
+	denseSlots.push_back(slot);
+	fanOutHeads.emplace_back();
+	positions.emplace(positionKey(dense.back()->position), GateHandle{ slot, slots[slot].generation });
+	structureRevision++;
+	outputs.push_back(initialOutput(type));
+	nextOutputs.push_back(false);
+	selection.push_back(false);
+
+	return GateHandle{ slot, slots[slot].generation };
+}
+
+bool GateStore::connect(GateHandle src, GateHandle dst, int input, const std::vector<Point> &connectionPoints) {
+	Component *dstGate = get(dst);
+	if (!dstGate || !get(src)) { return false; }
+
+	if (input >= 0 && static_cast<size_t>(input) < dstGate->inputs.size()) {
+		disconnect(dst, input);
+	}
+	if (!dstGate->connectInput(src, input, static_cast<uint32_t>(routes.size()), static_cast<uint32_t>(connectionPoints.size()))) {
+		return false;
+	}
+	routes.insert(routes.end(), connectionPoints.begin(), connectionPoints.end());
+	structureRevision++;
+
+	// Add the input to the front of the fan-out list of src
+	size_t srcIndex = indexOf(src);
+	dstGate->inputs[input].next = fanOutHeads[srcIndex];
+	fanOutHeads[srcIndex] = { dst, input };
+	return true;
+}
+
+bool GateStore::disconnect(GateHandle dst, int input) {
+	Component *dstGate = get(dst);
+	if (!dstGate || input < 0 || static_cast<size_t>(input) >= dstGate->inputs.size()) { return false; }
+
+	InputPath &path = dstGate->inputs[input];
+	structureRevision++;
+	removeFanOut(path.src, dst, input);
+	path.src = GateHandle{};
+	releaseRoute(path);
+	return true;
+}
+
+void GateStore::removeFanOut(GateHandle src, GateHandle dst, int input) {
+	if (!get(src)) { return; }
+
+	FanOut *link = &fanOutHeads[indexOf(src)];
+	while (Component *gate = get(link->dst)) {
+		InputPath &path = gate->inputs[link->input];
+		if (link->dst == dst && link->input == input) {
+			*link = path.next;
+			path.next = FanOut{};
+			return;
+		}
+		link = &path.next;
+	}
+}
+
+void GateStore::releaseRoute(InputPath &path) {
+	unusedRoutePoints += path.pointCount;
+	path.pointOffset = 0;
+	path.pointCount = 0;
+
+	// Rebuild the buffer once most of it is paths that have been replaced or removed
+	if (unusedRoutePoints > 4096 && unusedRoutePoints * 2 > routes.size()) {
+		compactRoutes();
+	}
+}
+
+void GateStore::compactRoutes() {
+	std::vector<Point> compacted;
+	compacted.reserve(routes.size() - unusedRoutePoints);
+
+	for (Component *gate : dense) {
+		for (auto &path : gate->inputs) {
+			auto offset = static_cast<uint32_t>(compacted.size());
+			compacted.insert(compacted.end(), routes.begin() + path.pointOffset, routes.begin() + path.pointOffset + path.pointCount);
+			path.pointOffset = offset;
+		}
+	}
+
+	routes.swap(compacted);
+	unusedRoutePoints = 0;
+}
+
+void GateStore::removePosition(GateHandle handle, Point position) {
+	auto it = positions.find(positionKey(position));
+	if (it != positions.end() && it->second == handle) {
+		positions.erase(it);
+	}
+}
+
+void GateStore::setOutput(size_t index, bool value) {
+	outputs.set(index, value);
+	if (allOutputsChanged) { return; }
+
+	if (changedOutputs.size() >= std::max<size_t>(64, dense.size() / 16)) {
+		markAllOutputsChanged();
+		return;
+	}
+	changedOutputs.push_back(static_cast<uint32_t>(index));
+}
+
+void GateStore::setPosition(GateHandle handle, Point position) {
+	Component *gate = get(handle);
+	if (!gate) { return; }
+
+	// Gates moved together can temporarily share a tile, the last gate moved onto a tile owns it
+	removePosition(handle, gate->position);
+	gate->position = position;
+	positions[positionKey(position)] = handle;
+}
+
+void GateStore::setName(GateHandle handle, const std::string &name) {
+	Component *gate = get(handle);
+	if (!gate) { return; }
+
+	if (name.empty()) {
+		gate->name = 0;
+		return;
+	}
+
+	auto it = nameIndices.try_emplace(name, static_cast<uint32_t>(names.size())).first;
+	if (it->second == names.size()) {
+		names.push_back(name);
+	}
+	gate->name = it->second;
+}
+
+std::string GateStore::label(Component &gate) const {
+	return gate.name ? names[gate.name] : gateTypeName(gate.getType());
+}
+
+GateHandle GateStore::at(Point point) const {
+	auto it = positions.find(positionKey(point));
+	return it != positions.end() ? it->second : GateHandle{};
+}
+
+void GateStore::remove(GateHandle handle) {
+	if (get(handle)) {
+		removeAt(slots[handle.index].dense);
+	}
+}
+
+void GateStore::removeAt(size_t index) {
+	size_t last = dense.size() - 1;
+	GateHandle handle = handleAt(index);
+	Component *gate = dense[index];
+	structureRevision++;
+
+	// Disconnect the inputs of the removed gate and all inputs reading its output
+	for (size_t input = 0; input < gate->inputs.size(); input++) {
+		removeFanOut(gate->inputs[input].src, handle, input);
+		releaseRoute(gate->inputs[input]);
+	}
+	forEachFanOut(index, [&](const FanOut &output) {
+		InputPath &path = get(output.dst)->inputs[output.input];
+		path.src = GateHandle{};
+		path.next = FanOut{};
+		releaseRoute(path);
+	});
+	removePosition(handle, gate->position);
+
+	// Invalidate all handles to the removed gate
+	uint32_t slot = denseSlots[index];
+	slots[slot].generation++;
+	freeSlots.push_back(slot);
+	gate->~Component();
+	pool.deallocate(gate);
+
+	// Move the last gate into the hole
+	setSelectionBit(index, false);
+	if (index != last) {
+		bool lastSelected = isSelected(last);
+		setSelectionBit(last, false);
+		setSelectionBit(index, lastSelected);
+		outputs.set(index, outputs[last]);
+		nextOutputs.set(index, nextOutputs[last]);
+
+		dense[index] = dense[last];
+		denseSlots[index] = denseSlots[last];
+		fanOutHeads[index] = fanOutHeads[last];
+		slots[denseSlots[index]].dense = static_cast<uint32_t>(index);
+	}
+
+	dense.pop_back();
+	denseSlots.pop_back();
+	fanOutHeads.pop_back();
+	outputs.pop_back();
+	nextOutputs.pop_back();
+	selection.pop_back();
+}
+
+void GateStore::removeSelected() {
+	// Going backwards means that the gate swapped into a hole has already been visited
+	for (size_t word = selection.wordCount(); word-- > 0;) {
+		if (selection.word(word) == 0) { continue; }
+
+		for (int bit = 63; bit >= 0; bit--) {
+			if ((selection.word(word) >> bit) & 1) {
+				removeAt(word * 64 + bit);
+			}
+		}
+	}
+}
+
+void GateStore::clear() {
+	for (Component *gate : dense) {
+		gate->~Component();
+	}
+	pool.clear();
+	structureRevision++;
+
+	dense.clear();
+	denseSlots.clear();
+	fanOutHeads.clear();
+	routes.clear();
+	unusedRoutePoints = 0;
+	names.resize(1);
+	nameIndices.clear();
+	positions.clear();
+	outputs.clear();
+	nextOutputs.clear();
+	selection.clear();
+	selectedCount = 0;
+
+	// Keep the slots so that handles from before the clear stay invalid, they are reused from the first
+	freeSlots.clear();
+	for (uint32_t slot = static_cast<uint32_t>(slots.size()); slot-- > 0;) {
+		slots[slot].generation++;
+		freeSlots.push_back(slot);
+	}
+}
+
+void GateStore::reserve(size_t gateCount, size_t pointCount) {
+	pool.reserve(gateCount);
+	dense.reserve(gateCount);
+	denseSlots.reserve(gateCount);
+	fanOutHeads.reserve(gateCount);
+	slots.reserve(gateCount);
+	positions.reserve(gateCount);
+	outputs.reserve(gateCount);
+	nextOutputs.reserve(gateCount);
+	selection.reserve(gateCount);
+	routes.reserve(pointCount);
+}
+
+Component *GateStore::get(GateHandle handle) const {
+	if (!isValid(handle)) {
+		return nullptr;
+	}
+	return dense[slots[handle.index].dense];
+}
+
+GateHandle GateStore::handleAt(size_t index) const {
+	uint32_t slot = denseSlots[index];
+	return GateHandle{ slot, slots[slot].generation };
+}
+
+size_t GateStore::indexOf(GateHandle handle) const {
+	return slots[handle.index].dense;
+}
+
+bool GateStore::isSelected(GateHandle handle) const {
+	return get(handle) && isSelected(indexOf(handle));
+}
+
+void GateStore::setSelectionBit(size_t index, bool value) {
+	if (selection[index] != value) {
+		selection.set(index, value);
+		if (value) { selectedCount++; }
+		else { selectedCount--; }
+	}
+}
+
+void GateStore::selectAll() {
+	selection.fill(true);
+	selectedCount = dense.size();
+}
+
+void GateStore::deselectAll() {
+	selection.fill(false);
+	selectedCount = 0;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bitvector.h"
+#include "component.h"
+#include "pool.h"
+
+// Points of a connection path in the route buffer, only valid until the next connection is made
+template<typename T>
+struct PointRange {
+	T *first;
+	size_t count;
+
+	T *begin() const { return first; }
+	T *end() const { return first + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+};
+
+/*
+ * Slot map owning all gates. Gates are kept densely packed and removed by swapping with the last gate,
+ * while handles stay valid until their gate is removed. The outputs of the current and the next step
+ * and the selection are bitsets over the dense indices, so the state touched by the simulation is 2 bits per gate.
+ * The store also keeps the fan-out of every gate so that removing a gate disconnects the inputs reading it,
+ * and a hash of the gate positions so that finding the gate on a tile does not scan all gates.
+ * Components are allocated from a pool and the points of all connection paths share one buffer.
+ * Gates are unnamed unless a name is assigned, names are interned so each distinct name is stored once
+*/
+class GateStore {
+	struct Slot {
+		uint32_t dense;
+		uint32_t generation;
+	};
+
+	BlockPool pool{ componentSize };
+	std::vector<Component *> dense;
+	std::vector<uint32_t> denseSlots;
+	std::vector<FanOut> fanOutHeads;
+	std::unordered_map<uint64_t, GateHandle> positions;
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+
+	std::vector<Point> routes;
+	size_t unusedRoutePoints = 0;
+
+	BitVector outputs;
+	BitVector nextOutputs;
+	BitVector selection;
+	size_t selectedCount = 0;
+
+	// Changed whenever gates or connections are added or removed
+	uint64_t structureRevision = 0;
+	// Dense indices of the outputs set since the simulation engine last synced with the store, so it only
+	// copies those. Once there are more than copying all outputs costs, every output counts as changed
+	std::vector<uint32_t> changedOutputs;
+	bool allOutputsChanged = true;
+
+	std::vector<std::string> names{ std::string() };
+	std::unordered_map<std::string, uint32_t> nameIndices;
+
+	void setSelectionBit(size_t index, bool value);
+	bool isValid(GateHandle handle) const { return handle.index < slots.size() && slots[handle.index].generation == handle.generation; }
+	void removeFanOut(GateHandle src, GateHandle dst, int input);
+	void removePosition(GateHandle handle, Point position);
+	void releaseRoute(InputPath &path);
+	void compactRoutes();
+	static uint64_t positionKey(Point point) { return (uint64_t(uint32_t(point.x)) << 32) | uint32_t(point.y); }
+
+public:
+	GateStore() = default;
+	GateStore(const GateStore &) = delete;
+	GateStore &operator=(const GateStore &) = delete;
+	~GateStore();
+
+	GateHandle create(GateType type, Point point, uint64_t id = Component::GUID++);
+	// Connect src to the input of dst, replacing any previous connection to that input
+	bool connect(GateHandle src, GateHandle dst, int input, const std::vector<Point> &connectionPoints);
+	// Returns false if dst has been removed or has no such input
+	bool disconnect(GateHandle dst, int input);
+	void remove(GateHandle handle);
+	void removeAt(size_t index);
+	void removeSelected();
+	// Removes every gate, handles to them stay invalid once new gates are inserted
+	void clear();
+	// Make room for at least this many gates and route points in total
+	void reserve(size_t gateCount, size_t pointCount = 0);
+
+	// Returns nullptr if the gate has been removed
+	Component *get(GateHandle handle) const;
+	GateHandle handleAt(size_t index) const;
+	size_t indexOf(GateHandle handle) const;
+	// Returns the handle of the gate placed on the tile, which does not resolve if the tile is empty
+	GateHandle at(Point point) const;
+	void setPosition(GateHandle handle, Point position);
+	uint64_t revision() const { return structureRevision; }
+	// An empty name removes the name of the gate
+	void setName(GateHandle handle, const std::string &name);
+	// The name of the gate if it has one, otherwise the name of its type
+	std::string label(Component &gate) const;
+
+	PointRange<Point> route(const InputPath &path) { return { routes.data() + path.pointOffset, path.pointCount }; }
+	PointRange<const Point> route(const InputPath &path) const { return { routes.data() + path.pointOffset, path.pointCount }; }
+
+	// Calls function with every FanOut reading the gate
+	template<typename Function>
+	void forEachFanOut(size_t index, Function function) const {
+		for (FanOut output = fanOutHeads[index]; get(output.dst);) {
+			FanOut next = get(output.dst)->inputs[output.input].next;
+			function(output);
+			output = next;
+		}
+	}
+
+	size_t size() const { return dense.size(); }
+	bool empty() const { return dense.empty(); }
+	Component &operator[](size_t index) const { return *dense[index]; }
+	Component *back() const { return dense.back(); }
+	auto begin() const { return dense.begin(); }
+	auto end() const { return dense.end(); }
+
+	// Outputs of the last committed step, unconnected inputs read the output of a missing gate, which is off
+	bool output(size_t index) const { return outputs[index]; }
+	bool output(GateHandle handle) const { return isValid(handle) && outputs[slots[handle.index].dense]; }
+	void setOutput(size_t index, bool value);
+	void setOutput(GateHandle handle, bool value) { if (isValid(handle)) { setOutput(slots[handle.index].dense, value); } }
+	// The next step is written 64 gates at a time into the back buffer, and becomes current
+	// in commitOutputs by swapping the buffers, so every gate reads the outputs of the same step.
+	// Stepping the gates this way also steps the timers, so everything counts as changed
+	void setNextOutputs(size_t word, uint64_t bits) { nextOutputs.setWord(word, bits); }
+	void commitOutputs() { outputs.swap(nextOutputs); allOutputsChanged = true; }
+	// Outputs set since markOutputsSynced. If everything changed, the timer counters may have changed too
+	bool everyOutputChanged() const { return allOutputsChanged; }
+	const std::vector<uint32_t> &outputChanges() const { return changedOutputs; }
+	void markOutputsSynced() { changedOutputs.clear(); allOutputsChanged = false; }
+	void markAllOutputsChanged() { changedOutputs.clear(); allOutputsChanged = true; }
+
+	bool isSelected(size_t index) const { return selection[index]; }
+	bool isSelected(GateHandle handle) const;
+	size_t selectionSize() const { return selectedCount; }
+	void select(size_t index) { setSelectionBit(index, true); }
+	void deselect(size_t index) { setSelectionBit(index, false); }
+	void toggleSelection(size_t index) { setSelectionBit(index, !isSelected(index)); }
+	void selectAll();
+	void deselectAll();
+};
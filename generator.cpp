@@ -0,0 +1,83 @@
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "circuit.h"
+#include "generators.h"
+
+/*
+ * Writes a project file with a synthetic circuit that can be opened in the editor or used by the benchmark
+*/
+
+static void printUsage(const char *program) {
+	std::cerr << "Usage: " << program << " <adder|multiplier|shift|registers|sram|random|ring> [options]\n"
+		<< "  --bits N         width of adders, multipliers, registers and sram words (default 8)\n"
+		<< "  --words N        number of registers or sram words (default 16)\n"
+		<< "  --gates N        gates in random netlists, stages in shift registers and length of rings (default 1024)\n"
+		<< "  --latch nor|nand latch type used by sram (default nor)\n"
+		<< "  --seed N         seed of random netlists (default 1)\n"
+		<< "  --inputs R       fraction of inputs in random netlists (default 0.0625)\n"
+		<< "  --two-input R    fraction of two input gates in random netlists (default 0.8)\n"
+		<< "  --fan-out N      maximum fan-out in random netlists, 0 for unbounded (default 0)\n"
+		<< "  --feedback R     fraction of inputs connected to later gates in random netlists (default 0)\n"
+		<< "  --compressed     write the compressed project format instead of text\n"
+		<< "  --tiled          write the tiled project format, which the editor loads a region at a time\n"
+		<< "  -o path          output project file (default save.txt)\n";
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	std::string structure = argv[1];
+	std::string path = "save.txt";
+	int bits = 8;
+	int words = 16;
+	LatchType latch = LatchType::NOR;
+	RandomNetlistParameters parameters;
+	ProjectFormat format = ProjectFormat::TEXT;
+
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--bits" && hasValue) { bits = std::stoi(argv[++i]); }
+		else if (arg == "--words" && hasValue) { words = std::stoi(argv[++i]); }
+		else if (arg == "--gates" && hasValue) { parameters.gates = std::stoi(argv[++i]); }
+		else if (arg == "--latch" && hasValue) { latch = std::string(argv[++i]) == "nand" ? LatchType::NAND : LatchType::NOR; }
+		else if (arg == "--seed" && hasValue) { parameters.seed = static_cast<uint32_t>(std::stoul(argv[++i])); }
+		else if (arg == "--inputs" && hasValue) { parameters.inputRatio = std::stod(argv[++i]); }
+		else if (arg == "--two-input" && hasValue) { parameters.twoInputRatio = std::stod(argv[++i]); }
+		else if (arg == "--fan-out" && hasValue) { parameters.maxFanOut = std::stoi(argv[++i]); }
+		else if (arg == "--feedback" && hasValue) { parameters.feedbackRatio = std::stod(argv[++i]); }
+		else if (arg == "-o" && hasValue) { path = argv[++i]; }
+		else if (arg == "--compressed") { format = ProjectFormat::COMPRESSED; }
+		else if (arg == "--tiled") { format = ProjectFormat::TILED; }
+		else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	Circuit circuit;
+	circuit.projectFormat = format;
+	Point origin{ 0,0 };
+
+	if (structure == "adder") { generateRippleAdder(circuit, bits, origin); }
+	else if (structure == "multiplier") { generateMultiplier(circuit, bits, origin); }
+	else if (structure == "shift") { generateShiftRegister(circuit, parameters.gates, origin); }
+	else if (structure == "registers") { generateRegisterFile(circuit, words, bits, origin); }
+	else if (structure == "sram") { generateSram(circuit, words, bits, latch, origin); }
+	else if (structure == "random") { generateRandomNetlist(circuit, parameters, origin); }
+	else if (structure == "ring") { generateFeedbackRing(circuit, parameters.gates, origin); }
+	else {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	double time = circuit.saveProject(path);
+	std::cout << "Wrote " << circuit.gates.size() << " gates to " << path << " (" << std::filesystem::file_size(path) << " bytes) in " << time << "ms\n";
+	return 0;
+}
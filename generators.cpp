@@ -0,0 +1,313 @@
+#include <cmath>
+#include <random>
+
+#include "generators.h"
+
+static GateHandle addGate(Circuit &circuit, GateType type, Point point) {
+	return circuit.gates.create(type, point);
+}
+
+// Handles that do not refer to any gate are used for missing operands
+static bool isMissing(GateHandle gate) {
+	return gate == GateHandle{};
+}
+
+// Route the connection along the grid with at most two bends
+static std::vector<Point> routeConnection(Point src, Point dst) {
+	if (src.x == dst.x || src.y == dst.y) { return {}; }
+
+	int midY = (src.y + dst.y) / 2;
+	if (midY == src.y || midY == dst.y) {
+		return { Point{ dst.x, src.y } };
+	}
+	return { Point{ src.x, midY }, Point{ dst.x, midY } };
+}
+
+static void connectGates(Circuit &circuit, GateHandle src, GateHandle dst, int index) {
+	circuit.gates.connect(src, dst, index, routeConnection(circuit.gates.get(src)->position, circuit.gates.get(dst)->position));
+}
+
+static Point gridPoint(Point origin, int index, int width) {
+	return Point{ origin.x + index % width, origin.y + index / width };
+}
+
+struct AdderBits {
+	GateHandle sum;
+	GateHandle carry;
+};
+
+/*
+ * Add the given operands, a missing operand is treated as zero.
+ * The gates are placed in a 3x2 cell at point
+*/
+static AdderBits addBits(Circuit &circuit, GateHandle a, GateHandle b, GateHandle carry, Point point) {
+	if (isMissing(a)) { std::swap(a, carry); }
+	if (isMissing(b)) { std::swap(b, carry); }
+	if (isMissing(a)) { std::swap(a, b); }
+	if (isMissing(b)) { return { a, GateHandle{} }; }
+
+	// Half adder
+	auto halfSum = addGate(circuit, GateType::XOR, point);
+	connectGates(circuit, a, halfSum, 0);
+	connectGates(circuit, b, halfSum, 1);
+	auto halfCarry = addGate(circuit, GateType::AND, point + Point{ 1, 0 });
+	connectGates(circuit, a, halfCarry, 0);
+	connectGates(circuit, b, halfCarry, 1);
+	if (isMissing(carry)) { return { halfSum, halfCarry }; }
+
+	// Sum = a ^ b ^ carry, carry = (a & b) | (carry & (a ^ b))
+	auto sum = addGate(circuit, GateType::XOR, point + Point{ 0, 1 });
+	connectGates(circuit, halfSum, sum, 0);
+	connectGates(circuit, carry, sum, 1);
+	auto propagate = addGate(circuit, GateType::AND, point + Point{ 1, 1 });
+	connectGates(circuit, halfSum, propagate, 0);
+	connectGates(circuit, carry, propagate, 1);
+	auto carryOut = addGate(circuit, GateType::OR, point + Point{ 2, 0 });
+	connectGates(circuit, halfCarry, carryOut, 0);
+	connectGates(circuit, propagate, carryOut, 1);
+	return { sum, carryOut };
+}
+
+// Q = (D & E) | (Q & !E), the gates are placed in a 2x2 cell at point
+static GateHandle addLatch(Circuit &circuit, const GateHandle &data, const GateHandle &enable, const GateHandle &notEnable, Point point) {
+	auto write = addGate(circuit, GateType::AND, point);
+	auto hold = addGate(circuit, GateType::AND, point + Point{ 0, 1 });
+	auto q = addGate(circuit, GateType::OR, point + Point{ 1, 0 });
+	connectGates(circuit, data, write, 0);
+	connectGates(circuit, enable, write, 1);
+	connectGates(circuit, q, hold, 0);
+	connectGates(circuit, notEnable, hold, 1);
+	connectGates(circuit, write, q, 0);
+	connectGates(circuit, hold, q, 1);
+	return q;
+}
+
+struct InvertedGate {
+	GateHandle gate;
+	GateHandle out;
+};
+
+// NOR is an OR followed by a NOT and NAND an AND followed by a NOT, placed vertically at point
+static InvertedGate addInverted(Circuit &circuit, GateType type, Point point) {
+	auto gate = addGate(circuit, type, point);
+	auto out = addGate(circuit, GateType::NOT, point + Point{ 0, 1 });
+	connectGates(circuit, gate, out, 0);
+	return { gate, out };
+}
+
+void generateRippleAdder(Circuit &circuit, int bits, Point origin) {
+	GateHandle carry = addGate(circuit, GateType::INPUT, origin + Point{ 2, 0 });
+
+	for (int bit = 0; bit < bits; bit++) {
+		int x = origin.x + bit * 3;
+
+		auto a = addGate(circuit, GateType::INPUT, Point{ x, origin.y });
+		auto b = addGate(circuit, GateType::INPUT, Point{ x + 1, origin.y });
+		AdderBits result = addBits(circuit, a, b, carry, Point{ x, origin.y + 2 });
+
+		auto out = addGate(circuit, GateType::WIRE, Point{ x, origin.y + 4 });
+		connectGates(circuit, result.sum, out, 0);
+		carry = result.carry;
+	}
+}
+
+void generateMultiplier(Circuit &circuit, int bits, Point origin) {
+	std::vector<GateHandle> a;
+	for (int bit = 0; bit < bits; bit++) {
+		a.push_back(addGate(circuit, GateType::INPUT, Point{ origin.x + bit * 3, origin.y }));
+	}
+
+	std::vector<GateHandle> products;
+	std::vector<GateHandle> sums;
+	GateHandle top;
+
+	// One row of partial products per bit of b, added to the shifted sum of the previous rows
+	for (int row = 0; row < bits; row++) {
+		int y = origin.y + 2 + row * 3;
+		auto b = addGate(circuit, GateType::INPUT, Point{ origin.x - 2, y });
+
+		std::vector<GateHandle> rowSums;
+		GateHandle carry;
+		for (int bit = 0; bit < bits; bit++) {
+			int x = origin.x + bit * 3;
+			auto partial = addGate(circuit, GateType::AND, Point{ x + 2, y + 1 });
+			connectGates(circuit, a[bit], partial, 0);
+			connectGates(circuit, b, partial, 1);
+
+			if (row == 0) {
+				rowSums.push_back(partial);
+				continue;
+			}
+
+			GateHandle shifted = bit + 1 < bits ? sums[bit + 1] : top;
+			AdderBits result = addBits(circuit, shifted, partial, carry, Point{ x, y });
+			rowSums.push_back(result.sum);
+			carry = result.carry;
+		}
+
+		products.push_back(rowSums[0]);
+		sums = std::move(rowSums);
+		top = carry;
+	}
+	for (int bit = 1; bit < bits; bit++) {
+		products.push_back(sums[bit]);
+	}
+	if (!isMissing(top)) { products.push_back(top); }
+
+	int y = origin.y + 2 + bits * 3;
+	for (int bit = 0; bit < static_cast<int>(products.size()); bit++) {
+		auto out = addGate(circuit, GateType::WIRE, Point{ origin.x + bit * 3, y });
+		connectGates(circuit, products[bit], out, 0);
+	}
+}
+
+void generateShiftRegister(Circuit &circuit, int stages, Point origin) {
+	auto clock = addGate(circuit, GateType::TIMER, origin);
+	auto notClock = addGate(circuit, GateType::NOT, origin + Point{ 0, 1 });
+	connectGates(circuit, clock, notClock, 0);
+
+	GateHandle data = addGate(circuit, GateType::INPUT, origin + Point{ 0, 3 });
+	for (int stage = 0; stage < stages; stage++) {
+		Point point = origin + Point{ 2 + stage * 4, 0 };
+
+		// The master is open while the clock is low and the slave while it is high
+		auto master = addLatch(circuit, data, notClock, clock, point);
+		data = addLatch(circuit, master, clock, notClock, point + Point{ 2, 0 });
+	}
+}
+
+void generateRegisterFile(Circuit &circuit, int registers, int bits, Point origin) {
+	std::vector<GateHandle> data;
+	for (int bit = 0; bit < bits; bit++) {
+		data.push_back(addGate(circuit, GateType::TIMER, Point{ origin.x + 2 + bit * 3, origin.y }));
+	}
+
+	for (int reg = 0; reg < registers; reg++) {
+		int y = origin.y + 2 + reg * 3;
+		auto enable = addGate(circuit, GateType::INPUT, Point{ origin.x, y });
+		auto notEnable = addGate(circuit, GateType::NOT, Point{ origin.x, y + 1 });
+		connectGates(circuit, enable, notEnable, 0);
+
+		for (int bit = 0; bit < bits; bit++) {
+			addLatch(circuit, data[bit], enable, notEnable, Point{ origin.x + 2 + bit * 3, y });
+		}
+	}
+}
+
+void generateSram(Circuit &circuit, int words, int bits, LatchType latch, Point origin) {
+	GateType holdType = latch == LatchType::NOR ? GateType::OR : GateType::AND;
+
+	// Bit lines and their complement
+	std::vector<GateHandle> bitLines;
+	std::vector<GateHandle> notBitLines;
+	for (int bit = 0; bit < bits; bit++) {
+		Point point{ origin.x + 2 + bit * 4, origin.y };
+		bitLines.push_back(addGate(circuit, GateType::TIMER, point));
+		notBitLines.push_back(addGate(circuit, GateType::NOT, point + Point{ 1, 0 }));
+		connectGates(circuit, bitLines.back(), notBitLines.back(), 0);
+	}
+
+	for (int word = 0; word < words; word++) {
+		int y = origin.y + 2 + word * 3;
+		auto wordLine = addGate(circuit, GateType::INPUT, Point{ origin.x, y });
+
+		for (int bit = 0; bit < bits; bit++) {
+			int x = origin.x + 2 + bit * 4;
+
+			// NOR latches are set by high inputs and NAND latches by low inputs
+			GateHandle set;
+			GateHandle reset;
+			if (latch == LatchType::NOR) {
+				set = addGate(circuit, GateType::AND, Point{ x, y });
+				reset = addGate(circuit, GateType::AND, Point{ x + 1, y });
+				connectGates(circuit, bitLines[bit], set, 0);
+				connectGates(circuit, wordLine, set, 1);
+				connectGates(circuit, notBitLines[bit], reset, 0);
+				connectGates(circuit, wordLine, reset, 1);
+			}
+			else {
+				InvertedGate setGate = addInverted(circuit, GateType::AND, Point{ x, y });
+				InvertedGate resetGate = addInverted(circuit, GateType::AND, Point{ x + 1, y });
+				connectGates(circuit, bitLines[bit], setGate.gate, 0);
+				connectGates(circuit, wordLine, setGate.gate, 1);
+				connectGates(circuit, notBitLines[bit], resetGate.gate, 0);
+				connectGates(circuit, wordLine, resetGate.gate, 1);
+				set = setGate.out;
+				reset = resetGate.out;
+			}
+
+			// Cross coupled pair, for NOR latches q is driven by reset and for NAND latches by set
+			InvertedGate q = addInverted(circuit, holdType, Point{ x + 2, y });
+			InvertedGate notQ = addInverted(circuit, holdType, Point{ x + 3, y });
+			connectGates(circuit, latch == LatchType::NOR ? reset : set, q.gate, 0);
+			connectGates(circuit, notQ.out, q.gate, 1);
+			connectGates(circuit, latch == LatchType::NOR ? set : reset, notQ.gate, 0);
+			connectGates(circuit, q.out, notQ.gate, 1);
+		}
+	}
+}
+
+void generateRandomNetlist(Circuit &circuit, const RandomNetlistParameters &parameters, Point origin) {
+	static const GateType twoInputTypes[] = { GateType::AND, GateType::OR, GateType::XOR };
+	static const GateType oneInputTypes[] = { GateType::NOT, GateType::WIRE };
+
+	std::mt19937 rng(parameters.seed);
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	int count = parameters.gates;
+	int width = std::max(1, static_cast<int>(std::sqrt(count)));
+	int inputCount = std::max(1, static_cast<int>(count * parameters.inputRatio));
+	size_t first = circuit.gates.size();
+
+	for (int i = 0; i < count; i++) {
+		Point point = gridPoint(origin, i, width);
+
+		if (i < inputCount) {
+			addGate(circuit, i % 4 == 0 ? GateType::TIMER : GateType::INPUT, point);
+		}
+		else if (chance(rng) < parameters.twoInputRatio) {
+			addGate(circuit, twoInputTypes[rng() % 3], point);
+		}
+		else {
+			addGate(circuit, oneInputTypes[rng() % 2], point);
+		}
+	}
+
+	// Pick a source in [low, high) that is still below the fan-out limit, -1 if none was found
+	std::vector<int> fanOut(count, 0);
+	auto pickSource = [&](int low, int high) {
+		for (int attempt = 0; attempt < 8; attempt++) {
+			int src = low + rng() % (high - low);
+			if (parameters.maxFanOut <= 0 || fanOut[src] < parameters.maxFanOut) {
+				return src;
+			}
+		}
+		return -1;
+	};
+
+	for (int i = inputCount; i < count; i++) {
+		GateHandle gate = circuit.gates.handleAt(first + i);
+
+		for (size_t input = 0; input < circuit.gates[first + i].inputs.size(); input++) {
+			bool feedback = i + 1 < count && chance(rng) < parameters.feedbackRatio;
+			int src = feedback ? pickSource(i + 1, count) : pickSource(0, i);
+
+			if (src >= 0) {
+				fanOut[src]++;
+				connectGates(circuit, circuit.gates.handleAt(first + src), gate, input);
+			}
+		}
+	}
+}
+
+void generateFeedbackRing(Circuit &circuit, int length, Point origin) {
+	const int width = 256;
+
+	auto first = addGate(circuit, GateType::NOT, origin);
+	auto prev = first;
+	for (int i = 1; i < length; i++) {
+		auto gate = addGate(circuit, GateType::WIRE, gridPoint(origin, i, width));
+		connectGates(circuit, prev, gate, 0);
+		prev = gate;
+	}
+	connectGates(circuit, prev, first, 0);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+
+#include "circuit.h"
+
+enum class LatchType { NOR, NAND };
+
+struct RandomNetlistParameters {
+	int gates = 1024;
+	uint32_t seed = 1;
+	// Fraction of the gates that are inputs or timers driving the rest of the netlist
+	double inputRatio = 1.0 / 16;
+	// Fraction of the logic gates with two inputs, the rest are NOT and wires
+	double twoInputRatio = 0.8;
+	// Upper bound of gates reading the same output, 0 for unbounded
+	int maxFanOut = 0;
+	// Fraction of the inputs connected to a gate created later, creating feedback loops
+	double feedbackRatio = 0;
+};
+
+/*
+ * Synthetic circuits, each appends its gates to the circuit starting at origin.
+ * All connections are routed along the grid so the circuits can be opened in the editor
+*/
+// N-bit ripple carry adder built from full adders
+void generateRippleAdder(Circuit &circuit, int bits, Point origin);
+// N-bit by N-bit array multiplier
+void generateMultiplier(Circuit &circuit, int bits, Point origin);
+// Chain of master-slave flip flops clocked by a timer
+void generateShiftRegister(Circuit &circuit, int stages, Point origin);
+// Registers of D latches sharing the data inputs, one enable input per register
+void generateRegisterFile(Circuit &circuit, int registers, int bits, Point origin);
+// Words of SR latches built from cross coupled NOR or NAND gates, one word line per word
+void generateSram(Circuit &circuit, int words, int bits, LatchType latch, Point origin);
+// Random netlist with controllable fan-in, fan-out and feedback
+void generateRandomNetlist(Circuit &circuit, const RandomNetlistParameters &parameters, Point origin);
+// Ring oscillator of a single NOT followed by wires feeding back into it
+void generateFeedbackRing(Circuit &circuit, int length, Point origin);
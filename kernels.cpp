@@ -0,0 +1,187 @@
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows the intrinsics anywhere, gcc and clang compile them only in functions targeting the instruction set
+#if defined(KERNELS_X86) && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+namespace {
+
+constexpr bool hasTwoInputs(GateType type) {
+	return type == GateType::AND || type == GateType::XOR || type == GateType::OR;
+}
+
+// Only the lowest bit of the result is used, so NOT flips just that bit
+template<GateType type>
+uint64_t apply(uint64_t a, uint64_t b) {
+	if constexpr (type == GateType::AND) { return a & b; }
+	else if constexpr (type == GateType::XOR) { return a ^ b; }
+	else if constexpr (type == GateType::OR) { return a | b; }
+	else if constexpr (type == GateType::WIRE) { return a; }
+	else { return a ^ 1; }
+}
+
+inline uint64_t readBit(const uint64_t *bits, uint32_t index) {
+	return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+// The inner loop always runs 64 times and has no branches, which lets the compiler vectorize it
+template<GateType type>
+void evaluateScalar(const uint64_t *outputs, uint64_t *nextOutputs, const uint32_t *firstInputs, const uint32_t *secondInputs, uint32_t firstWord, uint32_t wordCount) {
+	for (uint32_t word = firstWord; word < firstWord + wordCount; word++) {
+		const uint32_t *first = firstInputs + word * 64;
+		const uint32_t *second = secondInputs + word * 64;
+
+		uint64_t bits = 0;
+		for (int bit = 0; bit < 64; bit++) {
+			uint64_t a = readBit(outputs, first[bit]);
+			uint64_t b = hasTwoInputs(type) ? readBit(outputs, second[bit]) : 0;
+			bits |= apply<type>(a, b) << bit;
+		}
+		nextOutputs[word] = bits;
+	}
+}
+
+#ifdef KERNELS_X86
+
+/*
+ * AVX2, 8 gates at a time
+*/
+// Gathers the 32-bit words holding the bits and shifts each bit to the lowest bit of its lane
+TARGET_AVX2 inline __m256i gatherBitsAvx2(const int *words, const uint32_t *positions) {
+	__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(positions));
+	__m256i gathered = _mm256_i32gather_epi32(words, _mm256_srli_epi32(index, 5), 4);
+	return _mm256_srlv_epi32(gathered, _mm256_and_si256(index, _mm256_set1_epi32(31)));
+}
+
+template<GateType type>
+TARGET_AVX2 inline __m256i applyAvx2(__m256i a, __m256i b) {
+	if constexpr (type == GateType::AND) { return _mm256_and_si256(a, b); }
+	else if constexpr (type == GateType::XOR) { return _mm256_xor_si256(a, b); }
+	else if constexpr (type == GateType::OR) { return _mm256_or_si256(a, b); }
+	else if constexpr (type == GateType::WIRE) { return a; }
+	else { return _mm256_xor_si256(a, _mm256_set1_epi32(1)); }
+}
+
+template<GateType type>
+TARGET_AVX2 void evaluateAvx2(const uint64_t *outputs, uint64_t *nextOutputs, const uint32_t *firstInputs, const uint32_t *secondInputs, uint32_t firstWord, uint32_t wordCount) {
+	const int *words = reinterpret_cast<const int *>(outputs);
+
+	for (uint32_t word = firstWord; word < firstWord + wordCount; word++) {
+		uint64_t bits = 0;
+		for (int lane = 0; lane < 64; lane += 8) {
+			__m256i a = gatherBitsAvx2(words, firstInputs + word * 64 + lane);
+			__m256i b = hasTwoInputs(type) ? gatherBitsAvx2(words, secondInputs + word * 64 + lane) : _mm256_setzero_si256();
+
+			// Move the lowest bit of every lane into the sign bit and collect the signs
+			__m256i result = _mm256_slli_epi32(applyAvx2<type>(a, b), 31);
+			bits |= uint64_t(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(result)))) << lane;
+		}
+		nextOutputs[word] = bits;
+	}
+}
+
+/*
+ * AVX-512, 16 gates at a time
+*/
+TARGET_AVX512 inline __m512i gatherBitsAvx512(const int *words, const uint32_t *positions) {
+	__m512i index = _mm512_loadu_si512(positions);
+	__m512i gathered = _mm512_i32gather_epi32(_mm512_srli_epi32(index, 5), words, 4);
+	return _mm512_srlv_epi32(gathered, _mm512_and_si512(index, _mm512_set1_epi32(31)));
+}
+
+template<GateType type>
+TARGET_AVX512 inline __m512i applyAvx512(__m512i a, __m512i b) {
+	if constexpr (type == GateType::AND) { return _mm512_and_si512(a, b); }
+	else if constexpr (type == GateType::XOR) { return _mm512_xor_si512(a, b); }
+	else if constexpr (type == GateType::OR) { return _mm512_or_si512(a, b); }
+	else if constexpr (type == GateType::WIRE) { return a; }
+	else { return _mm512_xor_si512(a, _mm512_set1_epi32(1)); }
+}
+
+template<GateType type>
+TARGET_AVX512 void evaluateAvx512(const uint64_t *outputs, uint64_t *nextOutputs, const uint32_t *firstInputs, const uint32_t *secondInputs, uint32_t firstWord, uint32_t wordCount) {
+	const int *words = reinterpret_cast<const int *>(outputs);
+	const __m512i one = _mm512_set1_epi32(1);
+
+	for (uint32_t word = firstWord; word < firstWord + wordCount; word++) {
+		uint64_t bits = 0;
+		for (int lane = 0; lane < 64; lane += 16) {
+			__m512i a = gatherBitsAvx512(words, firstInputs + word * 64 + lane);
+			__m512i b = hasTwoInputs(type) ? gatherBitsAvx512(words, secondInputs + word * 64 + lane) : _mm512_setzero_si512();
+			bits |= uint64_t(_mm512_test_epi32_mask(applyAvx512<type>(a, b), one)) << lane;
+		}
+		nextOutputs[word] = bits;
+	}
+}
+
+#endif
+
+// Kernels indexed by GateType, Input and Timer have no inputs to evaluate
+const BatchKernel scalarKernels[] = {
+	evaluateScalar<GateType::AND>, evaluateScalar<GateType::XOR>, evaluateScalar<GateType::OR>,
+	evaluateScalar<GateType::WIRE>, evaluateScalar<GateType::NOT>, nullptr, nullptr
+};
+#ifdef KERNELS_X86
+const BatchKernel avx2Kernels[] = {
+	evaluateAvx2<GateType::AND>, evaluateAvx2<GateType::XOR>, evaluateAvx2<GateType::OR>,
+	evaluateAvx2<GateType::WIRE>, evaluateAvx2<GateType::NOT>, nullptr, nullptr
+};
+const BatchKernel avx512Kernels[] = {
+	evaluateAvx512<GateType::AND>, evaluateAvx512<GateType::XOR>, evaluateAvx512<GateType::OR>,
+	evaluateAvx512<GateType::WIRE>, evaluateAvx512<GateType::NOT>, nullptr, nullptr
+};
+#endif
+
+}
+
+KernelSet detectKernelSet() {
+#if defined(KERNELS_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+	if (!osSavesAvx) { return KernelSet::SCALAR; }
+
+	__cpuidex(info, 7, 0);
+	if ((info[1] & (1 << 16)) && (_xgetbv(0) & 0xe6) == 0xe6) { return KernelSet::AVX512; }
+	if (info[1] & (1 << 5)) { return KernelSet::AVX2; }
+#elif defined(KERNELS_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) { return KernelSet::AVX512; }
+	if (__builtin_cpu_supports("avx2")) { return KernelSet::AVX2; }
+#endif
+	return KernelSet::SCALAR;
+}
+
+const char *kernelSetName(KernelSet set) {
+	switch (set) {
+	case KernelSet::SCALAR:
+		return "scalar";
+	case KernelSet::AVX2:
+		return "avx2";
+	case KernelSet::AVX512:
+		return "avx512";
+	}
+	return "";
+}
+
+BatchKernel batchKernel(KernelSet set, GateType type) {
+	int index = static_cast<int>(type);
+#ifdef KERNELS_X86
+	if (set == KernelSet::AVX512) { return avx512Kernels[index]; }
+	if (set == KernelSet::AVX2) { return avx2Kernels[index]; }
+#endif
+	return scalarKernels[index];
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+#include "component.h"
+
+/*
+ * Kernels evaluating a batch of gates of one type on bit-packed outputs. Each gate reads its inputs
+ * at arbitrary positions, so the SIMD kernels gather the 32-bit words holding those bits, shift each
+ * lane by its bit offset and pack the lowest bits of the lanes back into words of 64 outputs
+*/
+enum class KernelSet { SCALAR, AVX2, AVX512 };
+
+// Evaluates the gates in words [firstWord, firstWord + wordCount), the input arrays hold 64 positions per word
+using BatchKernel = void (*)(const uint64_t *outputs, uint64_t *nextOutputs, const uint32_t *firstInputs, const uint32_t *secondInputs, uint32_t firstWord, uint32_t wordCount);
+
+// The widest kernels supported by the cpu and the operating system
+KernelSet detectKernelSet();
+const char *kernelSetName(KernelSet set);
+// Returns nullptr for the gate types without inputs
+BatchKernel batchKernel(KernelSet set, GateType type);
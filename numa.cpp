@@ -0,0 +1,66 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "numa.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Parses lists like "0-3,8-11"
+static std::vector<int> parseCpuList(const std::string &list) {
+	std::vector<int> cpus;
+	std::stringstream ss(list);
+	std::string range;
+	while (std::getline(ss, range, ',')) {
+		size_t dash = range.find('-');
+		try {
+			int first = std::stoi(range.substr(0, dash));
+			int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+			for (int cpu = first; cpu <= last; cpu++) {
+				cpus.push_back(cpu);
+			}
+		}
+		catch (const std::exception &) {
+			// Ignore malformed ranges
+		}
+	}
+	return cpus;
+}
+
+NumaTopology NumaTopology::detect() {
+	NumaTopology topology;
+
+#ifdef __linux__
+	for (int node = 0;; node++) {
+		std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		if (!file.is_open()) { break; }
+
+		std::string list;
+		std::getline(file, list);
+		topology.nodeCpus.push_back(parseCpuList(list));
+	}
+#endif
+
+	if (topology.nodeCpus.empty()) {
+		topology.nodeCpus.emplace_back();
+	}
+	return topology;
+}
+
+bool pinThreadToNode(const NumaTopology &topology, size_t node) {
+	if (node >= topology.nodeCount() || topology.nodeCpus[node].empty()) { return false; }
+
+#ifdef __linux__
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	for (int cpu : topology.nodeCpus[node]) {
+		CPU_SET(cpu, &cpus);
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*
+ * NUMA placement without libnuma. Memory is placed on the node of the thread that first writes a page,
+ * so arrays are allocated without touching them and each worker pinned to a node initializes its own range
+*/
+struct NumaTopology {
+	// Cpus of each node, read from sysfs on Linux. Elsewhere there is one node with an empty list
+	std::vector<std::vector<int>> nodeCpus;
+
+	static NumaTopology detect();
+	size_t nodeCount() const { return nodeCpus.size(); }
+};
+
+// Restricts the calling thread to the cpus of the node, returns false if that is not supported
+bool pinThreadToNode(const NumaTopology &topology, size_t node);
+
+// Array of trivial values whose pages are not touched when it is allocated
+template<typename T>
+class FirstTouchArray {
+	std::unique_ptr<T[]> values;
+	size_t count = 0;
+
+public:
+	// The values are uninitialized
+	void allocate(size_t size) {
+		values.reset(new T[size]);
+		count = size;
+	}
+	size_t size() const { return count; }
+	T *data() { return values.get(); }
+	const T *data() const { return values.get(); }
+	T &operator[](size_t index) { return values[index]; }
+	const T &operator[](size_t index) const { return values[index]; }
+	void swap(FirstTouchArray &other) {
+		values.swap(other.values);
+		std::swap(count, other.count);
+	}
+};
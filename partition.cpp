@@ -0,0 +1,147 @@
+#include <algorithm>
+
+#include "gatestore.h"
+#include "partition.h"
+
+double Partitioning::imbalance() const {
+	if (parts.empty()) { return 1.0; }
+
+	size_t largest = *std::max_element(partSizes.begin(), partSizes.end());
+	return static_cast<double>(largest) * partSizes.size() / parts.size();
+}
+
+std::vector<uint32_t> connectionOrder(const GateStore &gates) {
+	std::vector<uint32_t> order;
+	order.reserve(gates.size());
+	std::vector<bool> visited(gates.size());
+
+	auto visit = [&](size_t index) {
+		if (!visited[index]) {
+			visited[index] = true;
+			order.push_back(static_cast<uint32_t>(index));
+		}
+	};
+
+	// Breadth-first over inputs and outputs alike, the order itself is the queue
+	auto search = [&](size_t seed) {
+		if (visited[seed]) { return; }
+
+		size_t head = order.size();
+		visit(seed);
+		for (; head < order.size(); head++) {
+			uint32_t index = order[head];
+			for (auto &input : gates[index].inputs) {
+				if (gates.get(input.src)) {
+					visit(gates.indexOf(input.src));
+				}
+			}
+			gates.forEachFanOut(index, [&](const FanOut &output) {
+				visit(gates.indexOf(output.dst));
+			});
+		}
+	};
+
+	// Starting from the gates without inputs gives the level order of acyclic circuits
+	for (size_t i = 0; i < gates.size(); i++) {
+		bool hasInput = false;
+		for (auto &input : gates[i].inputs) {
+			hasInput = hasInput || gates.get(input.src);
+		}
+		if (!hasInput) {
+			search(i);
+		}
+	}
+	for (size_t i = 0; i < gates.size(); i++) {
+		search(i);
+	}
+
+	return order;
+}
+
+namespace {
+
+// Calls function with the dense index of every gate read by the gate or reading it
+template<typename Function>
+void forEachNeighbour(const GateStore &gates, size_t index, Function function) {
+	for (auto &input : gates[index].inputs) {
+		if (gates.get(input.src)) {
+			function(gates.indexOf(input.src));
+		}
+	}
+	gates.forEachFanOut(index, [&](const FanOut &output) {
+		function(gates.indexOf(output.dst));
+	});
+}
+
+}
+
+Partitioning partitionGates(const GateStore &gates, int partCount, const std::vector<uint32_t> &order) {
+	partCount = std::max(1, partCount);
+
+	Partitioning result;
+	result.parts.assign(gates.size(), 0);
+	result.partSizes.assign(partCount, 0);
+
+	// Connected gates are close to each other in the order, so consecutive ranges already cut few connections
+	for (size_t i = 0; i < order.size(); i++) {
+		auto part = static_cast<uint32_t>(i * partCount / order.size());
+		result.parts[order[i]] = part;
+		result.partSizes[part]++;
+	}
+
+	// Move gates to the part most of their neighbours are in, parts stay within about 3% of the average
+	size_t average = gates.size() / partCount;
+	size_t slack = std::max<size_t>(64, average / 32);
+	std::vector<uint32_t> neighbourCounts(partCount, 0);
+	std::vector<uint32_t> neighbourParts;
+
+	for (int pass = 0; pass < 4 && partCount > 1; pass++) {
+		size_t moved = 0;
+
+		for (uint32_t gate : order) {
+			uint32_t current = result.parts[gate];
+			forEachNeighbour(gates, gate, [&](size_t neighbour) {
+				uint32_t part = result.parts[neighbour];
+				if (neighbourCounts[part]++ == 0) {
+					neighbourParts.push_back(part);
+				}
+			});
+
+			uint32_t best = current;
+			if (result.partSizes[current] + slack > average) {
+				for (uint32_t part : neighbourParts) {
+					if (neighbourCounts[part] > neighbourCounts[best] && result.partSizes[part] < average + slack) {
+						best = part;
+					}
+				}
+			}
+
+			for (uint32_t part : neighbourParts) {
+				neighbourCounts[part] = 0;
+			}
+			neighbourParts.clear();
+
+			if (best != current) {
+				result.parts[gate] = best;
+				result.partSizes[current]--;
+				result.partSizes[best]++;
+				moved++;
+			}
+		}
+
+		if (moved == 0) { break; }
+	}
+
+	for (size_t gate = 0; gate < gates.size(); gate++) {
+		for (auto &input : gates[gate].inputs) {
+			if (gates.get(input.src)) {
+				result.connections++;
+				if (result.parts[gate] != result.parts[gates.indexOf(input.src)]) {
+					result.cutConnections++;
+				}
+			}
+		}
+	}
+
+	return result;
+}
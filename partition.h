@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class GateStore;
+
+// Assignment of every gate to one of the parts simulated by separate threads
+struct Partitioning {
+	// Part of each gate by dense index
+	std::vector<uint32_t> parts;
+	std::vector<size_t> partSizes;
+	size_t connections = 0;
+	// Connections between gates in different parts, each is a read from another thread's outputs
+	size_t cutConnections = 0;
+
+	// Size of the largest part relative to the average
+	double imbalance() const;
+};
+
+// Breadth-first order over the connections in both directions, starting from the gates without inputs
+std::vector<uint32_t> connectionOrder(const GateStore &gates);
+
+/*
+ * Splits the gates into parts of equal size with few connections between them. The connection order is
+ * cut into consecutive ranges, then gates on the boundaries are moved to the part most of their neighbours
+ * are in while that reduces the cut and keeps the parts within a few percent of the average size
+*/
+Partitioning partitionGates(const GateStore &gates, int partCount, const std::vector<uint32_t> &order);
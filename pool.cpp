@@ -0,0 +1,56 @@
+#include <algorithm>
+
+#include "pool.h"
+
+BlockPool::BlockPool(size_t blockSize) {
+	// Keep every block aligned like the chunk itself
+	const size_t alignment = alignof(std::max_align_t);
+	this->blockSize = (blockSize + alignment - 1) / alignment * alignment;
+}
+
+void BlockPool::addChunk(size_t blocks) {
+	chunks.emplace_back(new uint8_t[blocks * blockSize]);
+	chunkCapacity = blocks;
+	chunkUsed = 0;
+	capacity += blocks;
+}
+
+void *BlockPool::allocate() {
+	allocated++;
+
+	if (!freeBlocks.empty()) {
+		void *block = freeBlocks.back();
+		freeBlocks.pop_back();
+		return block;
+	}
+
+	if (chunks.empty() || chunkUsed == chunkCapacity) {
+		addChunk(std::max<size_t>(1024, capacity));
+	}
+	return chunks.back().get() + blockSize * chunkUsed++;
+}
+
+void BlockPool::deallocate(void *block) {
+	allocated--;
+	freeBlocks.push_back(block);
+}
+
+void BlockPool::reserve(size_t blocks) {
+	size_t available = freeBlocks.size() + (chunks.empty() ? 0 : chunkCapacity - chunkUsed);
+	if (allocated + available >= blocks) { return; }
+
+	// Blocks left in the current chunk are handed out through the free list
+	for (; !chunks.empty() && chunkUsed < chunkCapacity; chunkUsed++) {
+		freeBlocks.push_back(chunks.back().get() + blockSize * chunkUsed);
+	}
+	addChunk(blocks - allocated - freeBlocks.size());
+}
+
+void BlockPool::clear() {
+	chunks.clear();
+	freeBlocks.clear();
+	chunkCapacity = 0;
+	chunkUsed = 0;
+	capacity = 0;
+	allocated = 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * Fixed size blocks carved out of large chunks. Chunks double in size so that n blocks
+ * take O(log n) allocations, or a single allocation after reserve, and freed blocks are reused
+*/
+class BlockPool {
+	size_t blockSize;
+	std::vector<std::unique_ptr<uint8_t[]>> chunks;
+	size_t chunkCapacity = 0;
+	size_t chunkUsed = 0;
+	size_t capacity = 0;
+	size_t allocated = 0;
+	std::vector<void *> freeBlocks;
+
+	void addChunk(size_t blocks);
+
+public:
+	explicit BlockPool(size_t blockSize);
+
+	void *allocate();
+	void deallocate(void *block);
+	// Make room for at least this many blocks in total
+	void reserve(size_t blocks);
+	// Releases all chunks, the objects in the blocks must already have been destroyed
+	void clear();
+};
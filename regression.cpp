@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+#include "circuit.h"
+#include "regression.h"
+
+size_t RegressionReport::passed() const {
+	return std::count_if(jobs.begin(), jobs.end(), [](const RegressionJob &job) { return job.result.passed(); });
+}
+
+double RegressionReport::jobMs() const {
+	double total = 0;
+	for (auto &job : jobs) {
+		total += job.result.totalMs;
+	}
+	return total;
+}
+
+RegressionReport runRegression(Circuit &circuit, std::vector<RegressionJob> jobs, int workers, const StimulusOptions &options, const std::vector<size_t> &watched) {
+	auto start = std::chrono::high_resolution_clock::now();
+	RegressionReport report;
+	report.jobs = std::move(jobs);
+
+	// Everything shared by the workers is prepared before they start and only read afterwards
+	const SimulationEngine &engine = circuit.engine;
+	const GateStore &gates = circuit.gates;
+	circuit.engine.prepare(gates);
+	StimulusGates stimulusGates(gates);
+
+	std::atomic<size_t> nextJob{ 0 };
+	auto work = [&]() {
+		for (size_t i = nextJob++; i < report.jobs.size(); i = nextJob++) {
+			RegressionJob &job = report.jobs[i];
+
+			std::ifstream file(job.path);
+			std::ifstream expectations;
+			if (!job.expectationPath.empty()) {
+				expectations.open(job.expectationPath);
+			}
+			if (!file.is_open() || (!job.expectationPath.empty() && !expectations.is_open())) {
+				job.result.ok = false;
+				job.result.error = "Could not open " + (file.is_open() ? job.expectationPath : job.path);
+				continue;
+			}
+			StimulusOptions jobOptions = options;
+			jobOptions.expectations = job.expectationPath.empty() ? nullptr : &expectations;
+
+			// The state is first written by this thread, so it is placed on the node the job runs on
+			EngineState state;
+			engine.initState(gates, state);
+			auto setInput = [&](size_t dense, bool value) {
+				if (engine.output(state, dense) == value) { return false; }
+				engine.setOutput(state, dense, value);
+				return true;
+			};
+			auto output = [&](size_t dense) { return engine.output(state, dense); };
+			job.result = driveStimulus(file, stimulusGates, jobOptions, setInput, output, [&](int steps) { engine.runState(state, steps); });
+
+			for (size_t dense : watched) {
+				job.watched.push_back(engine.output(state, dense));
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	size_t threadCount = std::min<size_t>(std::max(1, workers), report.jobs.size());
+	for (size_t i = 1; i < threadCount; i++) {
+		threads.emplace_back(work);
+	}
+	work();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	report.wallMs = std::chrono::duration<double, std::milli>(end - start).count();
+	return report;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "stimulus.h"
+
+class Circuit;
+
+struct RegressionJob {
+	std::string path;
+	// Empty if the outputs are not checked
+	std::string expectationPath;
+	StimulusResult result;
+	// Outputs of the watched gates at the end of the run
+	std::vector<bool> watched;
+};
+
+struct RegressionReport {
+	std::vector<RegressionJob> jobs;
+	double wallMs = 0;
+
+	size_t passed() const;
+	// Sum of the time of every job, compared to wallMs it shows how well the jobs ran in parallel
+	double jobMs() const;
+};
+
+/*
+ * Runs the stimulus file of every job against the circuit with workers jobs at a time. The circuit is compiled once
+ * and shared read-only by all workers, each job simulates its own state starting from the outputs and timers
+ * of the GateStore, so the jobs do not affect each other or the circuit. The expectations of the options are
+ * replaced by the expectation file of each job. Watched gates are dense indices
+*/
+RegressionReport runRegression(Circuit &circuit, std::vector<RegressionJob> jobs, int workers, const StimulusOptions &options = {},
+	const std::vector<size_t> &watched = {});
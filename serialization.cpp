@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "serialization.h"
+
+void ByteWriter::writeVarint(uint64_t value) {
+	while (value >= 0x80) {
+		bytes.push_back(static_cast<uint8_t>(value) | 0x80);
+		value >>= 7;
+	}
+	bytes.push_back(static_cast<uint8_t>(value));
+}
+
+void ByteWriter::writeSignedVarint(int64_t value) {
+	writeVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void ByteWriter::writeBytes(const uint8_t *data, size_t size) {
+	bytes.insert(bytes.end(), data, data + size);
+}
+
+uint8_t ByteReader::readByte() {
+	if (offset >= size) {
+		failed = true;
+		return 0;
+	}
+	return data[offset++];
+}
+
+uint64_t ByteReader::readVarint() {
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		uint8_t byte = readByte();
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) { return value; }
+	}
+
+	failed = true;
+	return 0;
+}
+
+int64_t ByteReader::readSignedVarint() {
+	uint64_t value = readVarint();
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static void writeLength(std::vector<uint8_t> &out, size_t length) {
+	for (; length >= 255; length -= 255) {
+		out.push_back(255);
+	}
+	out.push_back(static_cast<uint8_t>(length));
+}
+
+static void writeSequence(std::vector<uint8_t> &out, const uint8_t *literals, size_t literalCount, size_t offset, size_t matchLength) {
+	size_t match = matchLength == 0 ? 0 : matchLength - 4;
+	out.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(match, 15)));
+	if (literalCount >= 15) { writeLength(out, literalCount - 15); }
+	out.insert(out.end(), literals, literals + literalCount);
+	if (matchLength == 0) { return; }
+
+	out.push_back(static_cast<uint8_t>(offset));
+	out.push_back(static_cast<uint8_t>(offset >> 8));
+	if (match >= 15) { writeLength(out, match - 15); }
+}
+
+void lzCompress(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+	const int hashBits = 14;
+	const uint32_t none = UINT32_MAX;
+	// Last position at which each hash of 4 bytes was seen
+	std::vector<uint32_t> table(size_t(1) << hashBits, none);
+	auto read32 = [&](size_t position) {
+		uint32_t value;
+		std::memcpy(&value, data + position, sizeof(value));
+		return value;
+	};
+
+	size_t anchor = 0;
+	size_t i = 0;
+	while (i + 4 <= size) {
+		uint32_t sequence = read32(i);
+		uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+		uint32_t candidate = table[hash];
+		table[hash] = static_cast<uint32_t>(i);
+
+		if (candidate == none || i - candidate > 0xffff || read32(candidate) != sequence) {
+			i++;
+			continue;
+		}
+
+		size_t length = 4;
+		while (i + length < size && data[candidate + length] == data[i + length]) {
+			length++;
+		}
+		writeSequence(out, data + anchor, i - anchor, i - candidate, length);
+		i += length;
+		anchor = i;
+	}
+	writeSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+bool lzDecompress(const uint8_t *data, size_t dataSize, uint8_t *out, size_t size) {
+	const uint8_t *in = data;
+	const uint8_t *end = data + dataSize;
+	size_t written = 0;
+	auto readLength = [&](size_t &length) {
+		uint8_t byte = 255;
+		while (byte == 255) {
+			if (in == end) { return false; }
+			byte = *in++;
+			length += byte;
+		}
+		return true;
+	};
+
+	while (in < end) {
+		uint8_t token = *in++;
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !readLength(literalCount)) { return false; }
+		if (literalCount > static_cast<size_t>(end - in) || literalCount > size - written) { return false; }
+		if (literalCount > 0) {
+			std::memcpy(out + written, in, literalCount);
+		}
+		in += literalCount;
+		written += literalCount;
+		if (in == end) { break; }
+
+		if (end - in < 2) { return false; }
+		size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+		size_t length = (token & 15) + 4;
+		if ((token & 15) == 15 && !readLength(length)) { return false; }
+		if (offset == 0 || offset > written || length > size - written) { return false; }
+		// Matches may overlap their own output, so they are copied a byte at a time
+		for (size_t i = 0; i < length; i++, written++) {
+			out[written] = out[written - offset];
+		}
+	}
+	return written == size;
+}
+
+void writeCompressedBlock(ByteWriter &out, const uint8_t *data, size_t size) {
+	std::vector<uint8_t> compressed;
+	lzCompress(data, size, compressed);
+	out.writeVarint(size);
+	out.writeVarint(compressed.size());
+	out.writeBytes(compressed.data(), compressed.size());
+}
+
+bool readVarint(std::istream &stream, uint64_t &value) {
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int byte = stream.get();
+		if (byte == EOF) { return false; }
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) { return true; }
+	}
+	return false;
+}
+
+bool CompressedBlockReader::next() {
+	if (failed) { return false; }
+	if (stream.peek() == EOF) { return false; }
+
+	uint64_t size = 0;
+	uint64_t compressedSize = 0;
+	// Incompressible data grows by a byte per 255 literals, larger sizes can only come from a corrupt file
+	if (!readVarint(stream, size) || !readVarint(stream, compressedSize) || size > (uint64_t(1) << 30) || compressedSize > size + size / 255 + 16) {
+		failed = true;
+		return false;
+	}
+
+	compressed.resize(compressedSize);
+	block.resize(size);
+	if (!stream.read(reinterpret_cast<char *>(compressed.data()), compressedSize)
+		|| !lzDecompress(compressed.data(), compressed.size(), block.data(), block.size())) {
+		failed = true;
+		return false;
+	}
+	return true;
+}
+
+bool readFile(const std::string &path, std::vector<uint8_t> &bytes) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) { return false; }
+
+	bytes.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+	return static_cast<bool>(file);
+}
+
+// Writes the data and flushes it from the page cache to the disk
+static bool syncFile(FILE *file) {
+	if (std::fflush(file) != 0) { return false; }
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+AtomicFileWriter::AtomicFileWriter(const std::string &path) : path(path) {
+	file = std::fopen((path + ".tmp").c_str(), "wb");
+	failed = !file;
+}
+
+AtomicFileWriter::~AtomicFileWriter() {
+	if (file) {
+		std::fclose(file);
+		std::remove((path + ".tmp").c_str());
+	}
+}
+
+bool AtomicFileWriter::write(const void *data, size_t size) {
+	failed = failed || std::fwrite(data, 1, size, file) != size;
+	return !failed;
+}
+
+bool AtomicFileWriter::commit() {
+	if (failed) { return false; }
+	bool synced = syncFile(file);
+	bool closed = std::fclose(file) == 0;
+	file = nullptr;
+	std::string tmpPath = path + ".tmp";
+	if (!synced || !closed) {
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	if (error) { return false; }
+
+#ifndef _WIN32
+	// The rename itself is only durable once the directory is flushed
+	std::string directory = std::filesystem::absolute(path).parent_path().string();
+	int fd = open(directory.c_str(), O_RDONLY);
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+#endif
+	return true;
+}
+
+bool writeFileAtomic(const std::string &path, const void *data, size_t size) {
+	AtomicFileWriter file(path);
+	return file.write(data, size) && file.commit();
+}
+
+bool writeFileAtomic(const std::string &path, const std::vector<uint8_t> &bytes) {
+	return writeFileAtomic(path, bytes.data(), bytes.size());
+}
+
+bool appendFile(const std::string &path, const void *data, size_t size) {
+	FILE *file = std::fopen(path.c_str(), "ab");
+	if (!file) { return false; }
+
+	bool written = std::fwrite(data, 1, size, file) == size && syncFile(file);
+	return std::fclose(file) == 0 && written;
+}
+
+BackgroundWriter::~BackgroundWriter() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+void BackgroundWriter::work() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		changed.wait(lock, [&]() { return stopping || !jobs.empty(); });
+		if (jobs.empty()) { return; }
+
+		std::function<void()> job = std::move(jobs.front());
+		jobs.pop_front();
+		busy = true;
+		lock.unlock();
+		job();
+		lock.lock();
+		busy = false;
+		changed.notify_all();
+	}
+}
+
+void BackgroundWriter::submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+		// The thread is started by the first job, tools that never save in the background do not pay for it
+		if (!thread.joinable()) {
+			thread = std::thread(&BackgroundWriter::work, this);
+		}
+	}
+	changed.notify_all();
+}
+
+void BackgroundWriter::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [&]() { return jobs.empty() && !busy; });
+}
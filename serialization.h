@@ -0,0 +1,129 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Little helpers for compact binary formats. Unsigned integers are written as LEB128 varints
+ * and signed integers are zigzag encoded first so that small negative numbers stay small
+*/
+class ByteWriter {
+public:
+	std::vector<uint8_t> bytes;
+
+	void writeByte(uint8_t value) { bytes.push_back(value); }
+	void writeVarint(uint64_t value);
+	void writeSignedVarint(int64_t value);
+	void writeBytes(const uint8_t *data, size_t size);
+};
+
+class ByteReader {
+	const uint8_t *data;
+	size_t size;
+	size_t offset = 0;
+	bool failed = false;
+
+public:
+	ByteReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+	explicit ByteReader(const std::vector<uint8_t> &bytes) : data(bytes.data()), size(bytes.size()) {}
+
+	// Reading past the end returns zeros and marks the reader as failed
+	uint8_t readByte();
+	uint64_t readVarint();
+	int64_t readSignedVarint();
+
+	bool ok() const { return !failed; }
+	size_t remaining() const { return size - offset; }
+	size_t position() const { return offset; }
+	void seek(size_t position) { offset = position; }
+};
+
+/*
+ * LZ77 compression in the style of LZ4, fast enough to run on every save. Each sequence is a token byte with
+ * the literal count in the high and the match length minus 4 in the low nibble, a nibble of 15 continues in
+ * bytes that are added until one is below 255. The literals follow, then the match as a 2 byte little endian
+ * offset back into the output. The last sequence has literals only
+*/
+void lzCompress(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+// Returns false unless the data decompresses to exactly size bytes
+bool lzDecompress(const uint8_t *data, size_t dataSize, uint8_t *out, size_t size);
+
+// Varints of a stream, returns false at the end of the stream
+bool readVarint(std::istream &stream, uint64_t &value);
+
+// Data compressed in independent blocks, each a varint size, a varint compressed size and the compressed bytes.
+// Writers end a block once it has grown past compressedBlockSize
+static constexpr size_t compressedBlockSize = 1 << 16;
+void writeCompressedBlock(ByteWriter &out, const uint8_t *data, size_t size);
+
+// Reads the blocks of a stream one at a time, so only a block of the file is decompressed in memory
+class CompressedBlockReader {
+	std::istream &stream;
+	std::vector<uint8_t> compressed;
+	std::vector<uint8_t> block;
+	bool failed = false;
+
+public:
+	explicit CompressedBlockReader(std::istream &stream) : stream(stream) {}
+
+	// Returns false at the end of the stream or if the block is corrupt
+	bool next();
+	const std::vector<uint8_t> &data() const { return block; }
+	bool ok() const { return !failed; }
+};
+
+bool readFile(const std::string &path, std::vector<uint8_t> &bytes);
+// Writes to a temporary file that is flushed to disk and renamed over path, so readers and a crash
+// during the write never see a partially written file
+bool writeFileAtomic(const std::string &path, const void *data, size_t size);
+bool writeFileAtomic(const std::string &path, const std::vector<uint8_t> &bytes);
+// Builds a file from several writes in a temporary file that only replaces path on commit, like writeFileAtomic
+class AtomicFileWriter {
+	std::string path;
+	FILE *file = nullptr;
+	bool failed = false;
+
+public:
+	explicit AtomicFileWriter(const std::string &path);
+	AtomicFileWriter(const AtomicFileWriter &) = delete;
+	AtomicFileWriter &operator=(const AtomicFileWriter &) = delete;
+	// Removes the temporary file unless it was committed
+	~AtomicFileWriter();
+
+	bool write(const void *data, size_t size);
+	// Flushes the file to disk and renames it over path
+	bool commit();
+};
+
+// Appends to the file and flushes it to disk
+bool appendFile(const std::string &path, const void *data, size_t size);
+
+// Runs jobs such as writing files in order on a thread of its own, so the caller does not wait for the disk
+class BackgroundWriter {
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::function<void()>> jobs;
+	bool busy = false;
+	bool stopping = false;
+
+	void work();
+
+public:
+	BackgroundWriter() = default;
+	BackgroundWriter(const BackgroundWriter &) = delete;
+	BackgroundWriter &operator=(const BackgroundWriter &) = delete;
+	// Finishes the jobs that were submitted
+	~BackgroundWriter();
+
+	void submit(std::function<void()> job);
+	// Returns once every submitted job has finished
+	void wait();
+};
@@ -0,0 +1,252 @@
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "circuit.h"
+#include "regression.h"
+#include "stimulus.h"
+#include "truthtable.h"
+
+/*
+ * Runs a saved project driven by stimulus files without the editor, see stimulus.h for the format.
+ * A single stimulus drives the circuit itself, several are run as independent jobs of a regression.
+ * Instead of a stimulus the truth table of a combinational block can be written
+*/
+
+static void printMismatches(const StimulusResult &result) {
+	for (auto &mismatch : result.mismatches) {
+		std::cout << "  step " << mismatch.step << ": gate " << mismatch.id << " at " << mismatch.position.x << "," << mismatch.position.y
+			<< " is " << !mismatch.expected << ", expected " << mismatch.expected << "\n";
+	}
+	if (result.mismatchCount > result.mismatches.size()) {
+		std::cout << "  and " << result.mismatchCount - result.mismatches.size() << " more mismatches\n";
+	}
+}
+
+static bool writeTruthTable(Circuit &circuit, const std::string &path, const std::string &selection, const std::string &referencePath) {
+	// The project may have been saved with a selection of its own
+	circuit.deselectAll();
+	if (selection.empty()) {
+		circuit.selectAllComponents();
+	}
+	else {
+		std::unordered_map<uint64_t, size_t> indices;
+		for (size_t i = 0; i < circuit.gates.size(); i++) {
+			indices[circuit.gates[i].id] = i;
+		}
+		std::stringstream ss(selection);
+		std::string id;
+		while (std::getline(ss, id, ',')) {
+			uint64_t value = 0;
+			auto result = std::from_chars(id.data(), id.data() + id.size(), value);
+			auto it = indices.end();
+			if (result.ec == std::errc() && result.ptr == id.data() + id.size()) {
+				it = indices.find(value);
+			}
+			if (it == indices.end()) {
+				std::cerr << "No gate with id " << id << "\n";
+				return false;
+			}
+			circuit.gates.select(it->second);
+		}
+	}
+
+	TruthTable table;
+	std::string error;
+	if (!extractTruthTable(circuit.gates, table, error)) {
+		std::cerr << error << "\n";
+		return false;
+	}
+	if (!table.write(path)) {
+		std::cerr << "Could not write " << path << "\n";
+		return false;
+	}
+	std::cout << "Wrote " << table.rowCount() << " rows of " << table.inputIds.size() << " inputs and " << table.outputIds.size() << " outputs to " << path << "\n";
+	if (referencePath.empty()) { return true; }
+
+	TruthTable reference;
+	if (!reference.read(referencePath)) {
+		std::cerr << "Could not read the truth table in " << referencePath << "\n";
+		return false;
+	}
+	std::vector<size_t> rows;
+	uint64_t count = 0;
+	if (!compareTruthTables(table, reference, rows, count, error)) {
+		std::cerr << error << "\n";
+		return false;
+	}
+	for (size_t row : rows) {
+		std::cout << "  row " << row << " differs from the reference\n";
+	}
+	std::cout << count << " of " << table.rowCount() << " rows differ from " << referencePath << "\n";
+	return count == 0;
+}
+
+// Expectations of tests/add.txt are in tests/add.expect
+static std::string expectationPath(const std::string &stimulusPath) {
+	return std::filesystem::path(stimulusPath).replace_extension(".expect").string();
+}
+
+static void printUsage(const char *program) {
+	std::cerr << "Usage: " << program << " <project> <stimulus|-> [more stimulus files] [options]\n"
+		<< "       " << program << " <project> --truth-table path [--select ids] [--reference path]\n"
+		<< "  --steps N        stop after N steps even if the stimulus goes on\n"
+		<< "  --threads N      simulate N parts of the circuit in parallel (default 1)\n"
+		<< "  --jobs N         stimulus files run at the same time (default the number of cpus)\n"
+		<< "  --engine batched|interpreted\n"
+		<< "  --watch id       print the output of the gate with this id at the end, can be repeated\n"
+		<< "  --expect         check the outputs against the .expect file next to each stimulus file\n"
+		<< "  --keep-going     count every mismatch instead of stopping at the first\n"
+		<< "  --truth-table p  write the truth table of the selected gates to p\n"
+		<< "  --select ids     comma separated ids of the gates in the block, all gates by default\n"
+		<< "  --reference p    compare the truth table with the one in p\n"
+		<< "A stimulus of - is read from stdin\n";
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	std::string projectPath = argv[1];
+	std::vector<std::string> stimulusPaths;
+	StimulusOptions options;
+	bool expect = false;
+	int jobs = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<uint64_t> watchedIds;
+	std::string truthTablePath;
+	std::string selection;
+	std::string referencePath;
+	Circuit circuit;
+
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--steps" && hasValue) { options.maxSteps = std::stoull(argv[++i]); }
+		else if (arg == "--threads" && hasValue) { circuit.engine.setThreadCount(std::stoi(argv[++i])); }
+		else if (arg == "--jobs" && hasValue) { jobs = std::stoi(argv[++i]); }
+		else if (arg == "--engine" && hasValue) {
+			std::string engine = argv[++i];
+			circuit.simulationMode = engine == "interpreted" ? SimulationMode::INTERPRETED : SimulationMode::BATCHED;
+		}
+		else if (arg == "--watch" && hasValue) { watchedIds.push_back(std::stoull(argv[++i])); }
+		else if (arg == "--expect") { expect = true; }
+		else if (arg == "--keep-going") { options.stopOnMismatch = false; }
+		else if (arg == "--truth-table" && hasValue) { truthTablePath = argv[++i]; }
+		else if (arg == "--select" && hasValue) { selection = argv[++i]; }
+		else if (arg == "--reference" && hasValue) { referencePath = argv[++i]; }
+		else if (arg.size() > 1 && arg[0] == '-' && arg[1] == '-') {
+			printUsage(argv[0]);
+			return 1;
+		}
+		else { stimulusPaths.push_back(arg); }
+	}
+
+	if (stimulusPaths.empty() == truthTablePath.empty()) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	if (circuit.loadProject(projectPath) < 0) {
+		std::cerr << "Could not open " << projectPath << "\n";
+		return 1;
+	}
+
+	if (!truthTablePath.empty()) {
+		return writeTruthTable(circuit, truthTablePath, selection, referencePath) ? 0 : 1;
+	}
+
+	std::vector<size_t> watched;
+	for (uint64_t id : watchedIds) {
+		bool found = false;
+		for (size_t i = 0; i < circuit.gates.size(); i++) {
+			if (circuit.gates[i].id == id) {
+				watched.push_back(i);
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			std::cerr << "No gate with id " << id << "\n";
+			return 1;
+		}
+	}
+
+	if (stimulusPaths.size() == 1) {
+		std::string stimulusPath = stimulusPaths.front();
+		std::ifstream file;
+		if (stimulusPath != "-") {
+			file.open(stimulusPath);
+			if (!file.is_open()) {
+				std::cerr << "Could not open " << stimulusPath << "\n";
+				return 1;
+			}
+		}
+
+		std::ifstream expectations;
+		if (expect) {
+			if (stimulusPath == "-") {
+				std::cerr << "--expect needs a stimulus file to find the expectations\n";
+				return 1;
+			}
+			expectations.open(expectationPath(stimulusPath));
+			if (!expectations.is_open()) {
+				std::cerr << "Could not open " << expectationPath(stimulusPath) << "\n";
+				return 1;
+			}
+			options.expectations = &expectations;
+		}
+
+		StimulusResult result = runStimulus(circuit, stimulusPath == "-" ? std::cin : file, options);
+		if (!result.ok) {
+			std::cerr << stimulusPath << ": " << result.error << "\n";
+		}
+		std::cout << "Simulated " << result.steps << " steps of " << circuit.gates.size() << " gates with " << result.inputChanges << " input changes in "
+			<< result.totalMs << "ms (" << result.steps / std::max(result.totalMs / 1000, 1e-9) << " steps/s)\n";
+		if (expect) {
+			std::cout << result.checks << " outputs checked, " << result.mismatchCount << " mismatches\n";
+			printMismatches(result);
+		}
+
+		for (size_t i = 0; i < watched.size(); i++) {
+			std::cout << watchedIds[i] << " " << circuit.gates.output(watched[i]) << "\n";
+		}
+		return result.passed() ? 0 : 1;
+	}
+
+	// Jobs run on the compiled circuit, so the interpreted engine does not apply
+	std::vector<RegressionJob> regressionJobs;
+	for (auto &path : stimulusPaths) {
+		regressionJobs.push_back({ path, expect ? expectationPath(path) : "", StimulusResult(), {} });
+	}
+	RegressionReport report = runRegression(circuit, std::move(regressionJobs), jobs, options, watched);
+	for (auto &job : report.jobs) {
+		std::cout << (job.result.passed() ? "PASS " : "FAIL ") << job.path << ": " << job.result.steps << " steps, " << job.result.inputChanges
+			<< " input changes in " << job.result.totalMs << "ms";
+		if (expect) {
+			std::cout << ", " << job.result.checks << " checks, " << job.result.mismatchCount << " mismatches";
+		}
+		if (!job.result.ok) {
+			std::cout << ", " << job.result.error;
+		}
+		std::cout << "\n";
+		printMismatches(job.result);
+
+		for (size_t i = 0; i < job.watched.size(); i++) {
+			std::cout << "  " << watchedIds[i] << " " << job.watched[i] << "\n";
+		}
+	}
+
+	size_t passed = report.passed();
+	std::cout << passed << " passed, " << report.jobs.size() - passed << " failed in " << report.wallMs << "ms with " << jobs << " jobs at a time ("
+		<< report.jobMs() << "ms of simulation, " << report.jobMs() / std::max(report.wallMs, 1e-9) << "x parallel)\n";
+	return passed == report.jobs.size() ? 0 : 1;
+}
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+
+#include "circuit.h"
+#include "stimulus.h"
+
+StimulusReader::StimulusReader(std::istream &stream) : stream(stream) {
+	hasPending = readCommand();
+}
+
+bool StimulusReader::fail(const std::string &message) {
+	errorMessage = "Line " + std::to_string(lineNumber) + ": " + message;
+	return false;
+}
+
+bool StimulusReader::readCommand() {
+	uint64_t previousStep = hasPending ? pending.step : 0;
+	std::string line;
+	while (std::getline(stream, line)) {
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+
+		std::stringstream ss(line);
+		std::string first;
+		if (!(ss >> first)) { continue; }
+
+		Command command;
+		try {
+			size_t parsed = 0;
+			command.step = std::stoull(first, &parsed);
+			if (parsed != first.size()) { return fail("Expected a step but got " + first); }
+		}
+		catch (const std::exception &) {
+			return fail("Expected a step but got " + first);
+		}
+		if (command.step < previousStep) {
+			return fail("Step " + std::to_string(command.step) + " is before the previous line");
+		}
+
+		std::string word;
+		ss >> word;
+		Pattern &pattern = command.pattern;
+		pattern.start = command.step;
+		if (word == "end") {
+			command.kind = Command::Kind::END;
+		}
+		else if (word == "clock") {
+			command.kind = Command::Kind::PATTERN;
+			pattern.bits = "10";
+			if (!(ss >> pattern.id >> pattern.hold) || pattern.hold == 0) {
+				return fail("Expected <step> clock <input id> <half period>");
+			}
+		}
+		else if (word == "repeat") {
+			command.kind = Command::Kind::PATTERN;
+			if (!(ss >> pattern.id >> pattern.hold >> pattern.bits) || pattern.hold == 0
+				|| pattern.bits.find_first_not_of("01") != std::string::npos) {
+				return fail("Expected <step> repeat <input id> <hold> <bits>");
+			}
+		}
+		else {
+			command.kind = Command::Kind::SET;
+			std::stringstream id(word);
+			if (!(id >> pattern.id) || !(ss >> pattern.bits) || (pattern.bits != "0" && pattern.bits != "1")) {
+				return fail("Expected <step> <input id> <0|1>");
+			}
+		}
+
+		std::string rest;
+		if (ss >> rest) { return fail("Unexpected " + rest); }
+
+		pending = command;
+		return true;
+	}
+	return false;
+}
+
+bool StimulusReader::advance(uint64_t step, const std::function<void(uint64_t id, bool value)> &set) {
+	if (!errorMessage.empty()) { return false; }
+
+	while (hasPending && pending.step <= step) {
+		Pattern &pattern = pending.pattern;
+		switch (pending.kind) {
+		case Command::Kind::SET:
+		case Command::Kind::PATTERN:
+			// A new value or pattern replaces the pattern the input had
+			patterns.erase(std::remove_if(patterns.begin(), patterns.end(), [&](const Pattern &active) { return active.id == pattern.id; }), patterns.end());
+			if (pending.kind == Command::Kind::SET) {
+				set(pattern.id, pattern.bits == "1");
+			}
+			else {
+				patterns.push_back(pattern);
+			}
+			break;
+		case Command::Kind::END:
+			endStep = std::min(endStep, pending.step);
+			break;
+		}
+
+		hasPending = readCommand();
+		if (!errorMessage.empty()) { return false; }
+	}
+
+	for (auto &pattern : patterns) {
+		if (step >= pattern.start && (step - pattern.start) % pattern.hold == 0) {
+			set(pattern.id, pattern.bits[(step - pattern.start) / pattern.hold % pattern.bits.size()] == '1');
+		}
+	}
+	return true;
+}
+
+uint64_t StimulusReader::nextChange(uint64_t step) const {
+	uint64_t next = endStep > step ? endStep : UINT64_MAX;
+	if (hasPending) {
+		next = std::min(next, std::max(pending.step, step + 1));
+	}
+	for (auto &pattern : patterns) {
+		uint64_t transition = pattern.start > step ? pattern.start : pattern.start + ((step - pattern.start) / pattern.hold + 1) * pattern.hold;
+		next = std::min(next, transition);
+	}
+	return next;
+}
+
+ExpectationReader::ExpectationReader(std::istream &stream) : stream(stream) {
+	hasPending = readExpectation();
+}
+
+bool ExpectationReader::readExpectation() {
+	uint64_t previousStep = pending.step;
+	std::string line;
+	while (std::getline(stream, line)) {
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+
+		std::stringstream ss(line);
+		std::string first;
+		if (!(ss >> first)) { continue; }
+
+		std::stringstream fields(line);
+		Expectation expectation;
+		std::string value;
+		std::string rest;
+		if (!(fields >> expectation.step >> expectation.id >> value) || (value != "0" && value != "1") || (fields >> rest)) {
+			errorMessage = "Line " + std::to_string(lineNumber) + ": Expected <step> <gate id> <0|1>";
+			return false;
+		}
+		if (expectation.step < previousStep) {
+			errorMessage = "Line " + std::to_string(lineNumber) + ": Step " + std::to_string(expectation.step) + " is before the previous line";
+			return false;
+		}
+
+		expectation.value = value == "1";
+		pending = expectation;
+		return true;
+	}
+	return false;
+}
+
+bool ExpectationReader::advance(uint64_t step, const std::function<void(uint64_t id, bool value)> &check) {
+	if (!errorMessage.empty()) { return false; }
+
+	while (hasPending && pending.step <= step) {
+		check(pending.id, pending.value);
+		hasPending = readExpectation();
+		if (!errorMessage.empty()) { return false; }
+	}
+	return true;
+}
+
+StimulusGates::StimulusGates(const GateStore &gates) : gates(gates) {
+	for (size_t i = 0; i < gates.size(); i++) {
+		all[gates[i].id] = i;
+		if (gates[i].getType() == GateType::INPUT) {
+			inputs[gates[i].id] = i;
+		}
+	}
+}
+
+StimulusResult driveStimulus(std::istream &stimulus, const StimulusGates &gates, const StimulusOptions &options,
+	const std::function<bool(size_t dense, bool value)> &setInput, const std::function<bool(size_t dense)> &output,
+	const std::function<void(int steps)> &simulate) {
+	auto start = std::chrono::high_resolution_clock::now();
+	StimulusResult result;
+
+	auto fail = [&](const std::string &error) {
+		if (result.ok) {
+			result.ok = false;
+			result.error = error;
+		}
+	};
+	auto set = [&](uint64_t id, bool value) {
+		auto it = gates.inputs.find(id);
+		if (it == gates.inputs.end()) {
+			fail("No input with id " + std::to_string(id));
+			return;
+		}
+		if (setInput(it->second, value)) {
+			result.inputChanges++;
+		}
+	};
+
+	uint64_t step = 0;
+	auto check = [&](uint64_t id, bool value) {
+		auto it = gates.all.find(id);
+		if (it == gates.all.end()) {
+			fail("No gate with id " + std::to_string(id));
+			return;
+		}
+		result.checks++;
+		if (output(it->second) != value) {
+			if (result.mismatches.size() < options.maxReported) {
+				result.mismatches.push_back({ step, id, gates.gates[it->second].position, value });
+			}
+			result.mismatchCount++;
+		}
+	};
+
+	StimulusReader reader(stimulus);
+	std::unique_ptr<ExpectationReader> expectations;
+	if (options.expectations) {
+		expectations = std::make_unique<ExpectationReader>(*options.expectations);
+	}
+
+	while (true) {
+		// Expectations see the outputs of the steps so far, before the inputs change
+		if (expectations && !expectations->advance(step, check)) {
+			fail("Expectations " + expectations->error());
+		}
+		if (result.mismatchCount > 0 && options.stopOnMismatch) { break; }
+
+		if (!reader.advance(step, set)) {
+			fail(reader.error());
+		}
+		if (!result.ok || step >= reader.end() || step >= options.maxSteps) { break; }
+
+		// Patterns would go on forever, without an end the run stops after the last line
+		bool moreChecks = expectations && expectations->hasMore();
+		if (!reader.hasMore() && !moreChecks && reader.end() == UINT64_MAX && options.maxSteps == UINT64_MAX) { break; }
+
+		uint64_t next = std::min(reader.nextChange(step), options.maxSteps);
+		if (expectations) {
+			next = std::min(next, expectations->nextCheck());
+		}
+		if (next == UINT64_MAX) { break; }
+		while (step < next) {
+			int steps = static_cast<int>(std::min<uint64_t>(next - step, INT_MAX));
+			simulate(steps);
+			step += steps;
+		}
+	}
+
+	if (result.ok && expectations && expectations->hasMore() && (result.mismatchCount == 0 || !options.stopOnMismatch)) {
+		fail("The run ended at step " + std::to_string(step) + " before the expectation at step " + std::to_string(expectations->nextCheck()));
+	}
+
+	result.steps = step;
+	auto end = std::chrono::high_resolution_clock::now();
+	result.totalMs = std::chrono::duration<double, std::milli>(end - start).count();
+	return result;
+}
+
+StimulusResult runStimulus(Circuit &circuit, std::istream &stimulus, const StimulusOptions &options) {
+	GateStore &gates = circuit.gates;
+	auto setInput = [&](size_t dense, bool value) {
+		if (gates.output(dense) == value) { return false; }
+		gates.setOutput(dense, value);
+		return true;
+	};
+	auto output = [&](size_t dense) { return gates.output(dense); };
+	return driveStimulus(stimulus, StimulusGates(gates), options, setInput, output, [&](int steps) { circuit.simulate(steps); });
+}
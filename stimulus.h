@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "component.h"
+
+class Circuit;
+
+/*
+ * Stimulus files drive the INPUT gates of a circuit through a test sequence without the editor.
+ * Every line starts with the step it takes effect at and lines must be in order of their step.
+ * Values are applied before the step is simulated, so a value set at step 10 is read by the gates
+ * during step 10 and the first gates to see it change their outputs after step 10.
+ *
+ *   # comment
+ *   <step> <input id> <0|1>                        set the input, ending any pattern on it
+ *   <step> clock <input id> <half period>          1 for half a period then 0, repeated
+ *   <step> repeat <input id> <hold> <bits>         each bit of the pattern held for hold steps, repeated
+ *   <step> end                                     stop the run at this step
+ *
+ * Input ids are the ids of the gates in the project file. The file is read line by line while the
+ * simulation runs, so only the patterns that are still active are kept in memory.
+*/
+class StimulusReader {
+	struct Pattern {
+		uint64_t id;
+		uint64_t start;
+		uint64_t hold;
+		std::string bits;
+	};
+
+	struct Command {
+		enum class Kind { SET, PATTERN, END } kind;
+		uint64_t step;
+		Pattern pattern;
+	};
+
+	std::istream &stream;
+	std::vector<Pattern> patterns;
+	// The first command after the steps applied so far, read ahead to know when it is due
+	Command pending;
+	bool hasPending = false;
+	uint64_t lineNumber = 0;
+	uint64_t endStep = UINT64_MAX;
+	std::string errorMessage;
+
+	bool readCommand();
+	bool fail(const std::string &message);
+
+public:
+	explicit StimulusReader(std::istream &stream);
+
+	// Calls set for every input assigned at the step, steps must be increasing. Returns false on an error
+	bool advance(uint64_t step, const std::function<void(uint64_t id, bool value)> &set);
+	// First step after step at which an input may change or the run ends, UINT64_MAX if there is none
+	uint64_t nextChange(uint64_t step) const;
+
+	// Step of the end command once it has been read
+	uint64_t end() const { return endStep; }
+	// Whether lines of the stimulus are left to apply
+	bool hasMore() const { return hasPending; }
+	const std::string &error() const { return errorMessage; }
+	uint64_t line() const { return lineNumber; }
+};
+
+/*
+ * Expected outputs checked while a stimulus runs, one <step> <gate id> <0|1> per line in order of the steps.
+ * The output of the gate after the first step steps is compared, before the inputs of the step are changed.
+ * Like stimulus files they are read line by line, so only the gates due at a step are looked at
+*/
+class ExpectationReader {
+	struct Expectation {
+		uint64_t step = 0;
+		uint64_t id = 0;
+		bool value = false;
+	};
+
+	std::istream &stream;
+	Expectation pending;
+	bool hasPending = false;
+	uint64_t lineNumber = 0;
+	std::string errorMessage;
+
+	bool readExpectation();
+
+public:
+	explicit ExpectationReader(std::istream &stream);
+
+	// Calls check for every expectation at the step. Returns false on an error
+	bool advance(uint64_t step, const std::function<void(uint64_t id, bool value)> &check);
+	// Step of the next expectation, UINT64_MAX if there is none
+	uint64_t nextCheck() const { return hasPending ? pending.step : UINT64_MAX; }
+	bool hasMore() const { return hasPending; }
+	const std::string &error() const { return errorMessage; }
+};
+
+struct StimulusMismatch {
+	uint64_t step;
+	uint64_t id;
+	Point position;
+	bool expected;
+};
+
+struct StimulusResult {
+	// False if the stimulus or expectations could not be read
+	bool ok = true;
+	std::string error;
+	uint64_t steps = 0;
+	uint64_t inputChanges = 0;
+	uint64_t checks = 0;
+	uint64_t mismatchCount = 0;
+	// The first mismatches, at most StimulusOptions::maxReported
+	std::vector<StimulusMismatch> mismatches;
+	double totalMs = 0;
+
+	bool passed() const { return ok && mismatchCount == 0; }
+};
+
+struct StimulusOptions {
+	uint64_t maxSteps = UINT64_MAX;
+	// Checked during the run if set
+	std::istream *expectations = nullptr;
+	// Otherwise the run goes on and counts every mismatch
+	bool stopOnMismatch = true;
+	size_t maxReported = 100;
+};
+
+class GateStore;
+
+// Gates a stimulus and its expectations refer to by id, looked up once and shared by every run on the circuit
+struct StimulusGates {
+	const GateStore &gates;
+	// Dense index of every INPUT gate
+	std::unordered_map<uint64_t, size_t> inputs;
+	// Dense index of every gate
+	std::unordered_map<uint64_t, size_t> all;
+
+	explicit StimulusGates(const GateStore &gates);
+};
+
+/*
+ * Runs a simulation driven by the stimulus until its end command, maxSteps or, without either, the last line
+ * of the stimulus or expectations. setInput assigns an input by dense index and returns whether its value changed,
+ * simulate runs as many steps as possible between changes of the inputs and checks of the outputs
+*/
+StimulusResult driveStimulus(std::istream &stimulus, const StimulusGates &gates, const StimulusOptions &options,
+	const std::function<bool(size_t dense, bool value)> &setInput, const std::function<bool(size_t dense)> &output,
+	const std::function<void(int steps)> &simulate);
+
+// Drives the inputs and outputs of the circuit's GateStore
+StimulusResult runStimulus(Circuit &circuit, std::istream &stimulus, const StimulusOptions &options = {});
@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "tiles.h"
+
+static const uint8_t tiledMagic[] = { 'L', 'S', 'T', 1 };
+
+static int floorDiv(int value, int divisor) {
+	return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+static bool inChunks(TiledProject::Chunk chunk, TiledProject::Chunk min, TiledProject::Chunk max) {
+	return chunk.x >= min.x && chunk.x <= max.x && chunk.y >= min.y && chunk.y <= max.y;
+}
+
+// Groups the gates of the snapshot into a segment per chunk, with the connections into them. Connections
+// into gates that are not in the snapshot are dropped
+static std::vector<TiledProject::Segment> splitSnapshot(const ProjectSnapshot &snapshot, int chunkSize) {
+	std::map<std::pair<int, int>, ProjectSnapshot> chunks;
+	std::unordered_map<uint64_t, ProjectSnapshot *> chunkOfGate;
+	chunkOfGate.reserve(snapshot.gates.size());
+	for (auto &gate : snapshot.gates) {
+		auto &chunk = chunks[{ floorDiv(gate.position.x, chunkSize), floorDiv(gate.position.y, chunkSize) }];
+		chunk.gates.push_back(gate);
+		chunkOfGate[gate.id] = &chunk;
+	}
+	for (auto &connection : snapshot.connections) {
+		auto it = chunkOfGate.find(connection.dst);
+		if (it != chunkOfGate.end()) {
+			it->second->addConnection(connection.dst, connection.src, connection.input, snapshot.points.data() + connection.pointOffset, connection.pointCount);
+		}
+	}
+
+	std::vector<TiledProject::Segment> segments;
+	for (auto &chunk : chunks) {
+		ByteWriter bytes;
+		writeSnapshotBlocks(chunk.second, bytes);
+
+		TiledProject::Segment segment;
+		segment.chunk = { chunk.first.first, chunk.first.second };
+		segment.gateCount = chunk.second.gates.size();
+		segment.size = bytes.bytes.size();
+		segment.bytes = std::move(bytes.bytes);
+		segments.push_back(std::move(segment));
+	}
+	return segments;
+}
+
+static std::vector<uint8_t> formatIndex(int chunkSize, uint64_t nextId, const ProjectView &view, const std::vector<TiledProject::Segment> &segments) {
+	ByteWriter index;
+	index.writeBytes(tiledMagic, sizeof(tiledMagic));
+	index.writeVarint(chunkSize);
+	index.writeVarint(nextId);
+	writeViewFields(view, index);
+	index.writeVarint(segments.size());
+	for (auto &segment : segments) {
+		index.writeSignedVarint(segment.chunk.x);
+		index.writeSignedVarint(segment.chunk.y);
+		index.writeVarint(segment.gateCount);
+		index.writeVarint(segment.size);
+	}
+	return std::move(index.bytes);
+}
+
+// Reads the index after the magic, the offsets of the segments are set from the end of the index
+static bool readIndex(std::istream &stream, int &chunkSize, uint64_t &nextId, ProjectView &view, std::vector<TiledProject::Segment> &segments) {
+	auto readSigned = [&](int &value) {
+		uint64_t zigzag = 0;
+		if (!readVarint(stream, zigzag)) { return false; }
+		value = static_cast<int>(static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1));
+		return true;
+	};
+
+	uint64_t size = 0;
+	uint64_t count = 0;
+	if (!readVarint(stream, size) || size == 0 || size > INT32_MAX || !readVarint(stream, nextId) || !readViewFields(stream, view)
+		|| !readVarint(stream, count)) {
+		return false;
+	}
+	chunkSize = static_cast<int>(size);
+
+	segments.clear();
+	for (uint64_t i = 0; i < count; i++) {
+		TiledProject::Segment segment;
+		if (!readSigned(segment.chunk.x) || !readSigned(segment.chunk.y) || !readVarint(stream, segment.gateCount) || !readVarint(stream, segment.size)) {
+			return false;
+		}
+		segments.push_back(std::move(segment));
+	}
+
+	uint64_t offset = static_cast<uint64_t>(stream.tellg());
+	for (auto &segment : segments) {
+		segment.offset = offset;
+		offset += segment.size;
+	}
+	return true;
+}
+
+bool TiledProject::isTiled(std::istream &stream) {
+	char magic[sizeof(tiledMagic)] = {};
+	return stream.read(magic, sizeof(magic)) && std::memcmp(magic, tiledMagic, sizeof(magic)) == 0;
+}
+
+bool TiledProject::write(const ProjectSnapshot &snapshot, const std::string &path, uint64_t nextId, int chunkSize) {
+	auto segments = splitSnapshot(snapshot, chunkSize);
+	auto index = formatIndex(chunkSize, nextId, snapshot.view, segments);
+
+	AtomicFileWriter file(path);
+	file.write(index.data(), index.size());
+	for (auto &segment : segments) {
+		file.write(segment.bytes.data(), segment.bytes.size());
+	}
+	return file.commit();
+}
+
+bool TiledProject::loadAll(std::istream &stream, GateStore &gates, ProjectView &view) {
+	int chunkSize = 0;
+	uint64_t nextId = 0;
+	std::vector<Segment> segments;
+	if (!readIndex(stream, chunkSize, nextId, view, segments)) { return false; }
+	Component::GUID = std::max(Component::GUID, nextId);
+
+	// Segments are in the order of the index, connections from later segments are made at the end
+	std::unordered_map<uint64_t, GateHandle> handles;
+	ProjectSnapshot unresolved;
+	for (size_t i = 0; i < segments.size(); i++) {
+		if (!loadSnapshotBlocks(stream, gates, handles, &unresolved)) { return false; }
+	}
+
+	for (auto &connection : unresolved.connections) {
+		auto src = handles.find(connection.src);
+		auto dst = handles.find(connection.dst);
+		if (src == handles.end() || dst == handles.end()) {
+			std::cout << "Gate not found when loading connections\n";
+			continue;
+		}
+		auto first = unresolved.points.begin() + connection.pointOffset;
+		gates.connect(src->second, dst->second, connection.input, std::vector<Point>(first, first + connection.pointCount));
+	}
+	return true;
+}
+
+bool TiledProject::open(const std::string &path_) {
+	std::ifstream file(path_, std::ios::binary);
+	if (!file.is_open() || !isTiled(file)) { return false; }
+
+	uint64_t nextId = 0;
+	if (!readIndex(file, chunkSize, nextId, view, segments)) { return false; }
+	// Gates created while chunks are not loaded must not reuse their ids
+	Component::GUID = std::max(Component::GUID, nextId);
+
+	path = path_;
+	unresolved = ProjectSnapshot();
+	loadedIds.clear();
+	removedIds.clear();
+	shownMin = Chunk{ 0, 0 };
+	shownMax = Chunk{ -1, -1 };
+	return true;
+}
+
+TiledProject::Chunk TiledProject::chunkOf(Point point) const {
+	return Chunk{ floorDiv(point.x, chunkSize), floorDiv(point.y, chunkSize) };
+}
+
+static std::unordered_set<uint64_t> idsOf(const GateStore &gates) {
+	std::unordered_set<uint64_t> ids;
+	ids.reserve(gates.size());
+	for (size_t i = 0; i < gates.size(); i++) {
+		ids.insert(gates[i].id);
+	}
+	return ids;
+}
+
+void TiledProject::forgetRemoved(std::unordered_set<uint64_t> present) {
+	for (uint64_t id : loadedIds) {
+		if (!present.count(id)) {
+			removedIds.insert(id);
+		}
+	}
+	loadedIds = std::move(present);
+}
+
+void TiledProject::loadedChunks(Point min, Point max, Chunk &loadMin, Chunk &loadMax) const {
+	Chunk first = chunkOf(min);
+	Chunk last = chunkOf(max);
+	loadMin = Chunk{ first.x - 1, first.y - 1 };
+	loadMax = Chunk{ last.x + 1, last.y + 1 };
+}
+
+bool TiledProject::pagesFor(Point min, Point max) const {
+	Chunk loadMin, loadMax;
+	loadedChunks(min, max, loadMin, loadMax);
+	return !(loadMin == shownMin && loadMax == shownMax);
+}
+
+void TiledProject::showRegion(GateStore &gates, Point min, Point max) {
+	Chunk loadMin, loadMax;
+	loadedChunks(min, max, loadMin, loadMax);
+	if (loadMin == shownMin && loadMax == shownMax) { return; }
+	shownMin = loadMin;
+	shownMax = loadMax;
+
+	forgetRemoved(idsOf(gates));
+	pageIn(gates, loadMin, loadMax);
+	loadedIds = idsOf(gates);
+	// Gates are kept a chunk further than they are loaded, so moving back and forth over a border does not page
+	pageOut(gates, Chunk{ loadMin.x - 1, loadMin.y - 1 }, Chunk{ loadMax.x + 1, loadMax.y + 1 });
+}
+
+void TiledProject::pageIn(GateStore &gates, Chunk min, Chunk max) {
+	auto due = std::partition(segments.begin(), segments.end(), [&](const Segment &segment) { return !inChunks(segment.chunk, min, max); });
+	if (due == segments.end()) { return; }
+
+	std::unordered_map<uint64_t, GateHandle> handles;
+	handles.reserve(gates.size());
+	for (size_t i = 0; i < gates.size(); i++) {
+		handles[gates[i].id] = gates.handleAt(i);
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	for (auto it = due; it != segments.end(); it++) {
+		bool loaded;
+		if (it->bytes.empty()) {
+			file.seekg(it->offset);
+			loaded = loadSnapshotBlocks(file, gates, handles, &unresolved);
+		}
+		else {
+			std::istringstream stream(std::string(it->bytes.begin(), it->bytes.end()));
+			loaded = loadSnapshotBlocks(stream, gates, handles, &unresolved);
+		}
+		if (!loaded) {
+			std::cout << "Wrong structure in chunk " << it->chunk.x << "," << it->chunk.y << " of " << path << "\n";
+		}
+	}
+	segments.erase(due, segments.end());
+
+	// Connect what the new gates complete, connections into gates that were removed are dropped
+	ProjectSnapshot stillUnresolved;
+	for (auto &connection : unresolved.connections) {
+		auto src = handles.find(connection.src);
+		auto dst = handles.find(connection.dst);
+		if (dst == handles.end() || !gates.get(dst->second) || removedIds.count(connection.src)) { continue; }
+
+		auto first = unresolved.points.begin() + connection.pointOffset;
+		if (src != handles.end() && gates.get(src->second)) {
+			gates.connect(src->second, dst->second, connection.input, std::vector<Point>(first, first + connection.pointCount));
+		}
+		else {
+			stillUnresolved.addConnection(connection.dst, connection.src, connection.input, &*first, connection.pointCount);
+		}
+	}
+	unresolved = std::move(stillUnresolved);
+}
+
+void TiledProject::pageOut(GateStore &gates, Chunk min, Chunk max) {
+	std::vector<bool> pagedOut(gates.size());
+	std::unordered_map<uint64_t, size_t> denseIndices;
+	bool any = false;
+	for (size_t i = 0; i < gates.size(); i++) {
+		pagedOut[i] = !inChunks(chunkOf(gates[i].position), min, max);
+		denseIndices[gates[i].id] = i;
+		any = any || pagedOut[i];
+	}
+	if (!any) { return; }
+
+	ProjectSnapshot paged;
+	ProjectSnapshot stillUnresolved;
+	std::vector<GateHandle> handles;
+	for (size_t i = 0; i < gates.size(); i++) {
+		auto &gate = gates[i];
+		for (size_t input = 0; input < gate.inputs.size(); input++) {
+			auto src = gates.get(gate.inputs[input].src);
+			if (!src) { continue; }
+
+			auto route = gates.route(gate.inputs[input]);
+			if (pagedOut[i]) {
+				paged.addConnection(gate.id, src->id, input, route.begin(), route.size());
+			}
+			else if (pagedOut[denseIndices[src->id]]) {
+				// Connections from paged out gates into loaded gates wait for their source to be loaded again
+				stillUnresolved.addConnection(gate.id, src->id, input, route.begin(), route.size());
+			}
+		}
+		if (pagedOut[i]) {
+			paged.gates.push_back(snapshotGate(gates, i));
+			handles.push_back(gates.handleAt(i));
+		}
+	}
+	for (auto &connection : unresolved.connections) {
+		auto it = denseIndices.find(connection.dst);
+		if (it == denseIndices.end()) { continue; }
+
+		auto &target = pagedOut[it->second] ? paged : stillUnresolved;
+		target.addConnection(connection.dst, connection.src, connection.input, unresolved.points.data() + connection.pointOffset, connection.pointCount);
+	}
+	unresolved = std::move(stillUnresolved);
+
+	// The chunks are kept in memory until they are saved, since their gates may have been edited
+	for (auto &segment : splitSnapshot(paged, chunkSize)) {
+		segments.push_back(std::move(segment));
+	}
+	for (GateHandle handle : handles) {
+		loadedIds.erase(gates.get(handle)->id);
+		gates.remove(handle);
+	}
+}
+
+std::shared_ptr<TiledSave> TiledProject::prepareSave(const ProjectSnapshot &loaded, const std::string &path_, uint64_t nextId) {
+	std::unordered_set<uint64_t> present;
+	for (auto &gate : loaded.gates) {
+		present.insert(gate.id);
+	}
+	forgetRemoved(std::move(present));
+
+	auto save = std::make_shared<TiledSave>();
+	save->loaded = loaded;
+	for (auto &connection : unresolved.connections) {
+		if (removedIds.count(connection.src)) { continue; }
+		save->loaded.addConnection(connection.dst, connection.src, connection.input, unresolved.points.data() + connection.pointOffset, connection.pointCount);
+	}
+	save->segments = segments;
+	save->previousPath = path;
+	save->path = path_;
+	save->chunkSize = chunkSize;
+	save->nextId = nextId;
+	return save;
+}
+
+bool TiledProject::writeSave(TiledSave &save) {
+	save.written = false;
+	auto written = splitSnapshot(save.loaded, save.chunkSize);
+	size_t loadedCount = written.size();
+	written.insert(written.end(), save.segments.begin(), save.segments.end());
+	auto index = formatIndex(save.chunkSize, save.nextId, save.loaded.view, written);
+
+	// Segments that are only in the old file are copied from it, which may be the file being replaced
+	AtomicFileWriter file(save.path);
+	std::ifstream previous(save.previousPath, std::ios::binary);
+	std::vector<char> buffer(compressedBlockSize);
+	file.write(index.data(), index.size());
+	for (auto &segment : written) {
+		if (!segment.bytes.empty()) {
+			file.write(segment.bytes.data(), segment.bytes.size());
+			continue;
+		}
+		previous.seekg(segment.offset);
+		for (uint64_t copied = 0; copied < segment.size;) {
+			size_t size = static_cast<size_t>(std::min<uint64_t>(buffer.size(), segment.size - copied));
+			if (!previous.read(buffer.data(), size)) { return false; }
+			file.write(buffer.data(), size);
+			copied += size;
+		}
+	}
+	previous.close();
+	if (!file.commit()) { return false; }
+
+	// The segments that are not loaded are now read from the new file
+	uint64_t offset = index.size();
+	save.segments.clear();
+	for (size_t i = 0; i < written.size(); i++) {
+		if (i >= loadedCount) {
+			Segment onDisk = written[i];
+			onDisk.offset = offset;
+			onDisk.bytes.clear();
+			save.segments.push_back(std::move(onDisk));
+		}
+		offset += written[i].size;
+	}
+	save.written = true;
+	return true;
+}
+
+void TiledProject::finishSave(const TiledSave &save) {
+	if (!save.written) { return; }
+	segments = save.segments;
+	path = save.path;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "circuit.h"
+
+struct TiledSave;
+
+/*
+ * Tiled projects store the gates in square chunks of the world, so that an editor can load only the chunks
+ * around the view of a project that does not fit in memory. The file is:
+ *   the bytes LST 1, varint chunk size, varint id of the next gate, the view as in compressed projects and
+ *   varint segment count
+ *   per segment the signed varint chunk x and y, varint gate count and varint size in bytes
+ *   the segments in the same order, each the blocks of a compressed project, see circuit.cpp
+ * A segment holds the gates of its chunk and every connection into them, wherever the source is. A chunk may
+ * have several segments, so that gates moved into a chunk that is not loaded can be written next to it.
+ *
+ * While a project is partially loaded, chunks paged out are kept compressed in memory until the next save,
+ * connections into loaded gates from gates that are not loaded are kept aside and made once their source is loaded.
+ * Chunks that are never loaded are saved as they are, so they may keep connections from gates removed elsewhere,
+ * which are skipped when the project is loaded
+*/
+class TiledProject {
+public:
+	struct Chunk {
+		int x;
+		int y;
+
+		bool operator==(const Chunk &other) const { return x == other.x && y == other.y; }
+	};
+
+	struct Segment {
+		Chunk chunk;
+		uint64_t gateCount = 0;
+		// Position in the file, if the bytes are not in memory
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		std::vector<uint8_t> bytes;
+	};
+
+	static constexpr int defaultChunkSize = 256;
+
+	// Reads the magic of a tiled project
+	static bool isTiled(std::istream &stream);
+	// Writes a snapshot of a whole project, nextId is the id the next gate created will have
+	static bool write(const ProjectSnapshot &snapshot, const std::string &path, uint64_t nextId, int chunkSize = defaultChunkSize);
+	// Loads every chunk of the stream after the magic, one segment at a time, and reads the view
+	static bool loadAll(std::istream &stream, GateStore &gates, ProjectView &view);
+
+	// Reads the index of the project, the gates are loaded by showRegion
+	bool open(const std::string &path);
+	// Loads the chunks within a chunk of the region and pages out gates more than two chunks away
+	void showRegion(GateStore &gates, Point min, Point max);
+	// Saving writes a snapshot of the loaded gates and the chunks that are not loaded to path, which is then the
+	// project's file. prepareSave copies what the save needs, so the save can be written on another thread with
+	// writeSave, and finishSave reads the chunks that are not loaded from the new file once it was written.
+	// Until then no chunks may be paged
+	std::shared_ptr<TiledSave> prepareSave(const ProjectSnapshot &loaded, const std::string &path, uint64_t nextId);
+	static bool writeSave(TiledSave &save);
+	void finishSave(const TiledSave &save);
+	// Whether showRegion would page chunks in or out for the region
+	bool pagesFor(Point min, Point max) const;
+
+	int getChunkSize() const { return chunkSize; }
+	// View saved with the project when it was opened
+	const ProjectView &getView() const { return view; }
+	// Segments that are not loaded
+	const std::vector<Segment> &getSegments() const { return segments; }
+
+private:
+	std::string path;
+	int chunkSize = defaultChunkSize;
+	ProjectView view;
+	std::vector<Segment> segments;
+	// Connections into loaded gates from gates that are not loaded
+	ProjectSnapshot unresolved;
+	// Ids of the gates loaded at the last page in or out, and of gates removed since the project was opened
+	std::unordered_set<uint64_t> loadedIds;
+	std::unordered_set<uint64_t> removedIds;
+	// Chunks within a chunk of the last region, so regions within the same chunks do nothing
+	Chunk shownMin{ 0, 0 };
+	Chunk shownMax{ -1, -1 };
+
+	Chunk chunkOf(Point point) const;
+	// The chunks loaded for a region
+	void loadedChunks(Point min, Point max, Chunk &loadMin, Chunk &loadMax) const;
+	// Loaded gates missing from present were removed by an edit, connections from them in chunks that are
+	// not loaded are dropped when the chunks are loaded or saved
+	void forgetRemoved(std::unordered_set<uint64_t> present);
+	// Loads the segments of the chunks in [min, max]
+	void pageIn(GateStore &gates, Chunk min, Chunk max);
+	// Pages out the gates outside the chunks in [min, max]
+	void pageOut(GateStore &gates, Chunk min, Chunk max);
+};
+
+// A save of a partially loaded project, written by TiledProject::writeSave
+struct TiledSave {
+	// The loaded gates, and the connections into them from gates that are not loaded
+	ProjectSnapshot loaded;
+	// Chunks that are not loaded, the ones without bytes are copied from the previous file
+	std::vector<TiledProject::Segment> segments;
+	std::string previousPath;
+	std::string path;
+	int chunkSize = TiledProject::defaultChunkSize;
+	uint64_t nextId = 0;
+
+	// Set once written, the segments are then those of the new file
+	std::atomic<bool> done{ false };
+	bool written = false;
+};
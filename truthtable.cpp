@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "gatestore.h"
+#include "truthtable.h"
+
+bool TruthTable::write(const std::string &path) const {
+	std::ofstream file(path);
+	if (!file.is_open()) { return false; }
+
+	file << "inputs";
+	for (uint64_t id : inputIds) { file << " " << id; }
+	file << "\noutputs";
+	for (uint64_t id : outputIds) { file << " " << id; }
+	file << "\n";
+
+	std::string row(inputIds.size() + 1 + outputIds.size(), ' ');
+	for (size_t r = 0; r < rowCount(); r++) {
+		for (size_t i = 0; i < inputIds.size(); i++) {
+			row[i] = (r >> i) & 1 ? '1' : '0';
+		}
+		for (size_t o = 0; o < outputIds.size(); o++) {
+			row[inputIds.size() + 1 + o] = columns[o][r] ? '1' : '0';
+		}
+		file << row << "\n";
+	}
+	return file.good();
+}
+
+bool TruthTable::read(const std::string &path) {
+	std::ifstream file(path);
+	if (!file.is_open()) { return false; }
+
+	auto readIds = [&](const char *name, std::vector<uint64_t> &ids) {
+		std::string line;
+		std::string word;
+		if (!std::getline(file, line)) { return false; }
+		std::stringstream ss(line);
+		if (!(ss >> word) || word != name) { return false; }
+		ids.clear();
+		for (uint64_t id; ss >> id;) { ids.push_back(id); }
+		return ss.eof();
+	};
+	if (!readIds("inputs", inputIds) || !readIds("outputs", outputIds) || inputIds.size() >= 64) { return false; }
+
+	columns.assign(outputIds.size(), BitVector());
+	for (auto &column : columns) {
+		column.assign(rowCount(), false);
+	}
+
+	std::string line;
+	for (size_t r = 0; r < rowCount(); r++) {
+		if (!std::getline(file, line) || line.size() < inputIds.size() + 1 + outputIds.size()) { return false; }
+		for (size_t o = 0; o < outputIds.size(); o++) {
+			columns[o].set(r, line[inputIds.size() + 1 + o] == '1');
+		}
+	}
+	return true;
+}
+
+bool extractTruthTable(const GateStore &gates, TruthTable &table, std::string &error, size_t maxInputs) {
+	// Every value lives in a slot of one word, slot 0 is always off and slot 1 always on
+	const uint32_t zeroSlot = 0;
+	const uint32_t oneSlot = 1;
+	std::vector<uint32_t> slots(gates.size(), UINT32_MAX);
+
+	std::vector<size_t> inputs;
+	std::vector<size_t> logic;
+	for (size_t i = 0; i < gates.size(); i++) {
+		if (!gates.isSelected(i)) { continue; }
+
+		GateType type = gates[i].getType();
+		if (type == GateType::INPUT) { inputs.push_back(i); }
+		else if (type == GateType::TIMER) { slots[i] = gates.output(i) ? oneSlot : zeroSlot; }
+		else { logic.push_back(i); }
+	}
+	if (inputs.size() > maxInputs) {
+		error = "The selection has " + std::to_string(inputs.size()) + " inputs, at most " + std::to_string(maxInputs) + " are supported";
+		return false;
+	}
+
+	auto byId = [&](size_t a, size_t b) { return gates[a].id < gates[b].id; };
+	std::sort(inputs.begin(), inputs.end(), byId);
+	uint32_t nextSlot = 2;
+	for (size_t i : inputs) {
+		slots[i] = nextSlot++;
+	}
+
+	// Gates are evaluated after the selected gates they read, which needs the selection to be free of loops.
+	// Unplaced selected gates have no slot yet
+	auto sourceSlot = [&](const InputPath &input) -> uint32_t {
+		if (!gates.get(input.src)) { return zeroSlot; }
+		size_t src = gates.indexOf(input.src);
+		if (gates.isSelected(src)) { return slots[src]; }
+		return gates.output(src) ? oneSlot : zeroSlot;
+	};
+	std::vector<uint32_t> pendingInputs(gates.size(), 0);
+	std::vector<size_t> order;
+	for (size_t i : logic) {
+		for (auto &input : gates[i].inputs) {
+			if (sourceSlot(input) == UINT32_MAX) { pendingInputs[i]++; }
+		}
+		if (pendingInputs[i] == 0) { order.push_back(i); }
+	}
+	for (size_t next = 0; next < order.size(); next++) {
+		slots[order[next]] = nextSlot++;
+		gates.forEachFanOut(order[next], [&](const FanOut &fanOut) {
+			size_t dst = gates.indexOf(fanOut.dst);
+			if (gates.isSelected(dst) && slots[dst] == UINT32_MAX && --pendingInputs[dst] == 0) {
+				order.push_back(dst);
+			}
+		});
+	}
+	if (order.size() < logic.size()) {
+		auto loop = std::find_if(logic.begin(), logic.end(), [&](size_t i) { return slots[i] == UINT32_MAX; });
+		error = "The selection is not combinational, gate " + std::to_string(gates[*loop].id) + " is part of or fed by a feedback loop";
+		return false;
+	}
+
+	struct Operation {
+		GateType type;
+		uint32_t first;
+		uint32_t second;
+		uint32_t result;
+	};
+	std::vector<Operation> operations;
+	for (size_t i : order) {
+		auto &component = gates[i];
+		uint32_t first = component.inputs.size() > 0 ? sourceSlot(component.inputs[0]) : zeroSlot;
+		uint32_t second = component.inputs.size() > 1 ? sourceSlot(component.inputs[1]) : zeroSlot;
+		operations.push_back({ component.getType(), first, second, slots[i] });
+	}
+
+	std::vector<size_t> outputs;
+	for (size_t i : logic) {
+		bool readInside = false;
+		bool readOutside = false;
+		gates.forEachFanOut(i, [&](const FanOut &fanOut) {
+			(gates.isSelected(gates.indexOf(fanOut.dst)) ? readInside : readOutside) = true;
+		});
+		if (readOutside || !readInside) {
+			outputs.push_back(i);
+		}
+	}
+	std::sort(outputs.begin(), outputs.end(), byId);
+
+	table.inputIds.clear();
+	table.outputIds.clear();
+	for (size_t i : inputs) { table.inputIds.push_back(gates[i].id); }
+	for (size_t i : outputs) { table.outputIds.push_back(gates[i].id); }
+	table.columns.assign(outputs.size(), BitVector());
+	for (auto &column : table.columns) {
+		column.assign(table.rowCount(), false);
+	}
+
+	// The first six inputs alternate within a word, the others are the same for all 64 rows of a word
+	const uint64_t lanePatterns[] = { 0xAAAAAAAAAAAAAAAA, 0xCCCCCCCCCCCCCCCC, 0xF0F0F0F0F0F0F0F0, 0xFF00FF00FF00FF00, 0xFFFF0000FFFF0000, 0xFFFFFFFF00000000 };
+	size_t rows = table.rowCount();
+	uint64_t rowMask = rows >= 64 ? ~uint64_t(0) : (uint64_t(1) << rows) - 1;
+	std::vector<uint64_t> values(nextSlot, 0);
+	values[oneSlot] = ~uint64_t(0);
+
+	for (size_t word = 0; word < (rows + 63) / 64; word++) {
+		for (size_t i = 0; i < inputs.size(); i++) {
+			values[2 + i] = i < 6 ? lanePatterns[i] : ((word >> (i - 6)) & 1 ? ~uint64_t(0) : 0);
+		}
+		for (const Operation &operation : operations) {
+			uint64_t a = values[operation.first];
+			uint64_t b = values[operation.second];
+			switch (operation.type) {
+			case GateType::AND: values[operation.result] = a & b; break;
+			case GateType::XOR: values[operation.result] = a ^ b; break;
+			case GateType::OR: values[operation.result] = a | b; break;
+			case GateType::WIRE: values[operation.result] = a; break;
+			case GateType::NOT: values[operation.result] = ~a; break;
+			default: break;
+			}
+		}
+		for (size_t o = 0; o < outputs.size(); o++) {
+			table.columns[o].setWord(word, values[slots[outputs[o]]] & rowMask);
+		}
+	}
+	return true;
+}
+
+bool compareTruthTables(const TruthTable &table, const TruthTable &reference, std::vector<size_t> &rows, uint64_t &count, std::string &error, size_t limit) {
+	if (table.inputIds != reference.inputIds || table.outputIds != reference.outputIds) {
+		error = "The tables have different inputs or outputs";
+		return false;
+	}
+
+	rows.clear();
+	count = 0;
+	for (size_t word = 0; word < (table.rowCount() + 63) / 64; word++) {
+		uint64_t differences = 0;
+		for (size_t o = 0; o < table.columns.size(); o++) {
+			differences |= table.columns[o].word(word) ^ reference.columns[o].word(word);
+		}
+		for (int bit = 0; differences && bit < 64; bit++) {
+			if ((differences >> bit) & 1) {
+				if (rows.size() < limit) {
+					rows.push_back(word * 64 + bit);
+				}
+				count++;
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bitvector.h"
+
+class GateStore;
+
+/*
+ * Truth table of a block of combinational gates. Row r sets input i to bit i of r.
+ * Files are text, a line with the input ids, a line with the output ids, then one line per row:
+ *
+ *   inputs 12 13
+ *   outputs 20
+ *   00 0
+ *   10 1
+ *   01 1
+ *   11 0
+*/
+struct TruthTable {
+	std::vector<uint64_t> inputIds;
+	std::vector<uint64_t> outputIds;
+	// One bit per row for each output
+	std::vector<BitVector> columns;
+
+	size_t rowCount() const { return size_t(1) << inputIds.size(); }
+	bool write(const std::string &path) const;
+	bool read(const std::string &path);
+};
+
+/*
+ * Evaluates every combination of the selected INPUT gates on the selected gates. Inputs from gates outside the
+ * selection and selected timers keep their current output. The outputs are the selected logic gates read by
+ * gates outside the selection or by none. Combinations are packed 64 to a word, so each gate is evaluated once
+ * per 64 rows. Fails if there are more than maxInputs inputs or the selection has a feedback loop
+*/
+bool extractTruthTable(const GateStore &gates, TruthTable &table, std::string &error, size_t maxInputs = 20);
+
+// Rows with different outputs, the first limit of them are listed. Fails if the inputs or outputs differ
+bool compareTruthTables(const TruthTable &table, const TruthTable &reference, std::vector<size_t> &rows, uint64_t &count, std::string &error, size_t limit = 20);